@@ -0,0 +1,53 @@
+#include "AdjustmentDialog.h"
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QDialogButtonBox>
+
+AdjustmentDialog::AdjustmentDialog(const QString& title, const QVector<Parameter>& parameters,
+                                   const Builder& builder, QWidget* parent)
+    : QDialog(parent)
+    , m_builder(builder)
+{
+    setWindowTitle(title);
+
+    QFormLayout* form = new QFormLayout(this);
+    for (const Parameter& parameter : parameters) {
+        QHBoxLayout* row = new QHBoxLayout();
+
+        QSlider* slider = new QSlider(Qt::Horizontal);
+        slider->setRange(parameter.minimum, parameter.maximum);
+        slider->setValue(parameter.value);
+        slider->setMinimumWidth(200);
+        row->addWidget(slider);
+
+        QLabel* valueLabel = new QLabel(QString::number(parameter.value));
+        valueLabel->setMinimumWidth(30);
+        row->addWidget(valueLabel);
+
+        form->addRow(parameter.label, row);
+        m_sliders.append(slider);
+
+        connect(slider, &QSlider::valueChanged, this, [this, valueLabel](int value) {
+            valueLabel->setText(QString::number(value));
+            rebuild();
+        });
+    }
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    form->addRow(buttons);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    rebuild();
+}
+
+void AdjustmentDialog::rebuild()
+{
+    QVector<int> values;
+    for (QSlider* slider : m_sliders)
+        values.append(slider->value());
+
+    m_adjustment = m_builder(values);
+    emit adjustmentChanged(m_adjustment);
+}
@@ -0,0 +1,40 @@
+#ifndef ADJUSTMENTDIALOG_H
+#define ADJUSTMENTDIALOG_H
+
+#include <QDialog>
+#include <QSlider>
+#include <QVector>
+#include <functional>
+#include "ColorAdjustment.h"
+
+// Диалог с ползунками параметров коррекции. При каждом изменении собирает
+// новую коррекцию и сообщает о ней, чтобы холст показал предпросмотр
+class AdjustmentDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    struct Parameter {
+        QString label;
+        int minimum;
+        int maximum;
+        int value;
+    };
+    using Builder = std::function<ColorAdjustment(const QVector<int>& values)>;
+
+    AdjustmentDialog(const QString& title, const QVector<Parameter>& parameters,
+                     const Builder& builder, QWidget* parent = nullptr);
+
+    ColorAdjustment adjustment() const { return m_adjustment; }
+
+signals:
+    void adjustmentChanged(const ColorAdjustment& adjustment);
+
+private:
+    void rebuild();
+
+    Builder m_builder;
+    QVector<QSlider*> m_sliders;
+    ColorAdjustment m_adjustment;
+};
+
+#endif // ADJUSTMENTDIALOG_H
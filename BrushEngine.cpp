@@ -0,0 +1,111 @@
+#include "BrushEngine.h"
+#include <QLineF>
+#include <QtMath>
+#include "Config.h"
+
+namespace
+{
+    // Сдвиг центра и радиус квантуются: соседние отпечатки попадают в один ключ кэша
+    const int SUBPIXEL_STEPS = 4;
+    const int RADIUS_STEPS = 4;
+}
+
+void BrushEngine::setBrush(qreal diameter, qreal hardness)
+{
+    m_diameter = qMax(1.0, diameter);
+
+    const int hardnessKey = qRound(qBound(0.0, hardness, 1.0) * 16);
+    if (hardnessKey != m_hardnessKey)
+        m_dabs.clear();
+    m_hardnessKey = hardnessKey;
+    m_hardness = hardnessKey / 16.0;
+}
+
+void BrushEngine::beginStroke(const QPointF& pos, qreal pressure)
+{
+    m_lastPos = pos;
+    m_lastPressure = pressure;
+    // Первый отпечаток ставится в точке нажатия
+    m_distanceToNext = 0.0;
+}
+
+QRect BrushEngine::strokeTo(StrokeBuffer& stroke, const QPointF& pos, qreal pressure)
+{
+    QRect dirty;
+    const qreal length = QLineF(m_lastPos, pos).length();
+    qreal travelled = m_distanceToNext;
+
+    while (travelled <= length) {
+        const qreal t = length > 0.0 ? travelled / length : 0.0;
+        const qreal dabPressure = m_lastPressure + (pressure - m_lastPressure) * t;
+        const qreal radius = qMax(0.5, m_diameter / 2.0 * dabPressure);
+        dirty |= stamp(stroke, m_lastPos + (pos - m_lastPos) * t, radius, dabPressure);
+
+        // Шаг - доля диаметра текущего отпечатка
+        travelled += qMax(BRUSH_DAB_MIN_SPACING, 2.0 * radius * BRUSH_DAB_SPACING);
+    }
+
+    m_distanceToNext = travelled - length;
+    m_lastPos = pos;
+    m_lastPressure = pressure;
+    return dirty;
+}
+
+const BrushEngine::Dab& BrushEngine::dab(qreal radius, qreal fractionX, qreal fractionY)
+{
+    const int radiusKey = qMax(2, qRound(radius * RADIUS_STEPS));
+    const int fx = qMin(SUBPIXEL_STEPS - 1, int(fractionX * SUBPIXEL_STEPS));
+    const int fy = qMin(SUBPIXEL_STEPS - 1, int(fractionY * SUBPIXEL_STEPS));
+    const quint32 key = (quint32(radiusKey) << 8) | (quint32(fx) << 4) | quint32(fy);
+
+    auto it = m_dabs.constFind(key);
+    if (it != m_dabs.constEnd())
+        return *it;
+
+    if (m_dabs.size() >= BRUSH_DAB_CACHE_LIMIT)
+        m_dabs.clear();
+
+    const qreal r = radiusKey / qreal(RADIUS_STEPS);
+    const qreal cx = (fx + 0.5) / SUBPIXEL_STEPS;
+    const qreal cy = (fy + 0.5) / SUBPIXEL_STEPS;
+    const int extent = qCeil(r) + 1;
+
+    Dab result;
+    result.left = -extent;
+    result.top = -extent;
+    result.width = 2 * extent + 1;
+    result.height = 2 * extent + 1;
+    result.coverage.resize(result.width * result.height);
+
+    // Профиль: до hardness * r полное покрытие, дальше квадратичный спад к краю.
+    // При нулевой жесткости это (1 - d/r)^2, как у прежней градиентной кисти.
+    const qreal core = m_hardness * r;
+    for (int y = 0; y < result.height; ++y) {
+        for (int x = 0; x < result.width; ++x) {
+            const qreal dx = result.left + x + 0.5 - cx;
+            const qreal dy = result.top + y + 0.5 - cy;
+            const qreal d = qSqrt(dx * dx + dy * dy);
+
+            qreal value = 0.0;
+            if (d < r) {
+                const qreal falloff = d <= core ? 1.0 : (r - d) / (r - core);
+                // Край жесткой кисти сглаживается на полпикселя
+                value = falloff * falloff * qMin(1.0, r - d + 0.5);
+            }
+            result.coverage[y * result.width + x] = uchar(qRound(value * 255));
+        }
+    }
+
+    return *m_dabs.insert(key, result);
+}
+
+QRect BrushEngine::stamp(StrokeBuffer& stroke, const QPointF& center, qreal radius, qreal opacity)
+{
+    const int baseX = qFloor(center.x());
+    const int baseY = qFloor(center.y());
+    const Dab& mask = dab(radius, center.x() - baseX, center.y() - baseY);
+
+    // Непрозрачность отпечатка умножается на покрытие при слиянии
+    const QRect rect(baseX + mask.left, baseY + mask.top, mask.width, mask.height);
+    return stroke.mergeMax(mask.coverage.constData(), mask.width, rect, quint32(qBound(0.0, opacity, 1.0) * 256));
+}
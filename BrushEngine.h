@@ -0,0 +1,49 @@
+#ifndef BRUSHENGINE_H
+#define BRUSHENGINE_H
+
+#include <QHash>
+#include <QVector>
+#include <QPointF>
+#include <QRect>
+#include "StrokeBuffer.h"
+
+// Мягкая кисть из отпечатков. Отпечаток - заранее посчитанная маска покрытия
+// для радиуса, жесткости и дробного сдвига центра; он берется из кэша и
+// сливается в черновик штриха по максимуму.
+// Отпечатки ставятся вдоль штриха через равные расстояния.
+class BrushEngine
+{
+public:
+    // diameter - размер кисти при полном нажиме, hardness 0..1 - доля радиуса без спада
+    void setBrush(qreal diameter, qreal hardness);
+
+    void beginStroke(const QPointF& pos, qreal pressure);
+    // Ведет штрих до pos и ставит все отпечатки по пути в stroke.
+    // Нажим уменьшает и радиус, и непрозрачность. Возвращает измененный прямоугольник.
+    QRect strokeTo(StrokeBuffer& stroke, const QPointF& pos, qreal pressure);
+
+private:
+    struct Dab
+    {
+        int left = 0;   // смещение маски относительно целой части центра
+        int top = 0;
+        int width = 0;
+        int height = 0;
+        QVector<uchar> coverage;
+    };
+
+    const Dab& dab(qreal radius, qreal fractionX, qreal fractionY);
+    QRect stamp(StrokeBuffer& stroke, const QPointF& center, qreal radius, qreal opacity);
+
+    qreal m_diameter = 1.0;
+    qreal m_hardness = 0.0;
+    int m_hardnessKey = 0;
+
+    QPointF m_lastPos;
+    qreal m_lastPressure = 1.0;
+    qreal m_distanceToNext = 0.0;
+
+    QHash<quint32, Dab> m_dabs;
+};
+
+#endif // BRUSHENGINE_H
@@ -0,0 +1,173 @@
+#include "ColorAdjustment.h"
+#include "Parallel.h"
+#include "Config.h"
+#include <QColor>
+#include <QtMath>
+#include <cmath>
+
+ColorAdjustment::ColorAdjustment()
+{
+    for (int c = 0; c < 3; ++c) {
+        for (int v = 0; v < 256; ++v)
+            m_lut[c][v] = uchar(v);
+    }
+}
+
+ColorAdjustment ColorAdjustment::levels(int inBlack, int inWhite, qreal gamma, int outBlack, int outWhite)
+{
+    ColorAdjustment adjustment;
+    const double range = qMax(1, inWhite - inBlack);
+    for (int v = 0; v < 256; ++v) {
+        double t = qBound(0.0, (v - inBlack) / range, 1.0);
+        t = qPow(t, 1.0 / qMax(0.01, gamma));
+        const uchar value = uchar(qBound(0, qRound(outBlack + t * (outWhite - outBlack)), 255));
+        for (int c = 0; c < 3; ++c)
+            adjustment.m_lut[c][v] = value;
+    }
+    adjustment.m_identity = (inBlack == 0 && inWhite == 255 && qFuzzyCompare(gamma, 1.0)
+                             && outBlack == 0 && outWhite == 255);
+    return adjustment;
+}
+
+ColorAdjustment ColorAdjustment::curves(int shadows, int midtones, int highlights)
+{
+    // Сплайн Катмулла-Рома через пять точек; касательные по соседям
+    const double xs[5] = { 0, 64, 128, 192, 255 };
+    const double ys[5] = { 0, double(shadows), double(midtones), double(highlights), 255 };
+    double tangents[5];
+    for (int i = 0; i < 5; ++i) {
+        const int prev = qMax(0, i - 1);
+        const int next = qMin(4, i + 1);
+        tangents[i] = (ys[next] - ys[prev]) / (xs[next] - xs[prev]);
+    }
+
+    ColorAdjustment adjustment;
+    for (int v = 0; v < 256; ++v) {
+        const int k = qMin(v / 64, 3);
+        const double dx = xs[k + 1] - xs[k];
+        const double t = (v - xs[k]) / dx;
+        const double t2 = t * t;
+        const double t3 = t2 * t;
+        const double y = (2 * t3 - 3 * t2 + 1) * ys[k] + (t3 - 2 * t2 + t) * dx * tangents[k]
+                         + (-2 * t3 + 3 * t2) * ys[k + 1] + (t3 - t2) * dx * tangents[k + 1];
+        const uchar value = uchar(qBound(0, qRound(y), 255));
+        for (int c = 0; c < 3; ++c)
+            adjustment.m_lut[c][v] = value;
+    }
+    adjustment.m_identity = (shadows == 64 && midtones == 128 && highlights == 192);
+    return adjustment;
+}
+
+ColorAdjustment ColorAdjustment::hueSaturation(int hue, int saturation, int lightness)
+{
+    ColorAdjustment adjustment;
+    if (hue == 0 && saturation == 0 && lightness == 0)
+        return adjustment;
+
+    // Сетка небольшая, поэтому узлы можно считать через QColor
+    const int size = COLOR_CUBE_SIZE;
+    const qreal shift = hue / 360.0;
+    const qreal gain = 1.0 + saturation / 100.0;
+    const qreal light = lightness / 100.0;
+    adjustment.m_cubeSize = size;
+    adjustment.m_cube.resize(size * size * size);
+    for (int r = 0; r < size; ++r) {
+        for (int g = 0; g < size; ++g) {
+            for (int b = 0; b < size; ++b) {
+                const QColor node(qRound(r * 255.0 / (size - 1)), qRound(g * 255.0 / (size - 1)),
+                                  qRound(b * 255.0 / (size - 1)));
+                float h, s, l;
+                node.getHslF(&h, &s, &l);
+                h = h < 0 ? 0.0f : float(std::fmod(h + shift + 1.0, 1.0));
+                s = float(qBound(0.0, s * gain, 1.0));
+                l = float(light > 0 ? l + (1.0 - l) * light : l * (1.0 + light));
+                adjustment.m_cube[(r * size + g) * size + b] = QColor::fromHslF(h, s, l).rgb();
+            }
+        }
+    }
+    adjustment.m_identity = false;
+    return adjustment;
+}
+
+ColorAdjustment ColorAdjustment::invert()
+{
+    ColorAdjustment adjustment;
+    for (int c = 0; c < 3; ++c) {
+        for (int v = 0; v < 256; ++v)
+            adjustment.m_lut[c][v] = uchar(255 - v);
+    }
+    adjustment.m_identity = false;
+    return adjustment;
+}
+
+QRgb ColorAdjustment::lookupCube(QRgb color) const
+{
+    // Положение между узлами сетки в 1/256, затем трилинейное смешение восьми узлов
+    const int last = m_cubeSize - 1;
+    int index[3];
+    int frac[3];
+    const int channels[3] = { qRed(color), qGreen(color), qBlue(color) };
+    for (int i = 0; i < 3; ++i) {
+        const int position = channels[i] * last * 256 / 255;
+        index[i] = qMin(position >> 8, last - 1);
+        frac[i] = position - (index[i] << 8);
+    }
+
+    qint64 sum[3] = { 0, 0, 0 };
+    for (int corner = 0; corner < 8; ++corner) {
+        qint64 weight = 1;
+        int offset = 0;
+        for (int i = 0; i < 3; ++i) {
+            const bool upper = corner & (4 >> i);
+            weight *= upper ? frac[i] : 256 - frac[i];
+            offset = offset * m_cubeSize + index[i] + (upper ? 1 : 0);
+        }
+        if (weight == 0)
+            continue;
+        const QRgb node = m_cube[offset];
+        sum[0] += weight * qRed(node);
+        sum[1] += weight * qGreen(node);
+        sum[2] += weight * qBlue(node);
+    }
+    return qRgb(int((sum[0] + (1 << 23)) >> 24), int((sum[1] + (1 << 23)) >> 24), int((sum[2] + (1 << 23)) >> 24));
+}
+
+void ColorAdjustment::apply(QImage& image, const QRect& rect,
+                            std::atomic<int>* progress, const std::atomic<bool>* cancel) const
+{
+    const QRect area = rect & image.rect();
+    if (area.isEmpty() || m_identity) {
+        if (progress)
+            *progress += area.height();
+        return;
+    }
+
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    Parallel::forRanges(area.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+        if (cancel && cancel->load())
+            return;
+
+        for (int y = area.top() + begin; y < area.top() + end; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(bits + y * stride);
+            for (int x = area.left(); x <= area.right(); ++x) {
+                const QRgb pixel = line[x];
+                const int alpha = qAlpha(pixel);
+                if (alpha == 0)
+                    continue;
+
+                // Непрозрачные пиксели (обычный случай) не нужно делить на альфу
+                const QRgb color = alpha == 255 ? pixel : qUnpremultiply(pixel);
+                const QRgb mapped = m_cubeSize
+                    ? lookupCube(color)
+                    : qRgb(m_lut[0][qRed(color)], m_lut[1][qGreen(color)], m_lut[2][qBlue(color)]);
+                const QRgb result = qRgba(qRed(mapped), qGreen(mapped), qBlue(mapped), alpha);
+                line[x] = alpha == 255 ? result : qPremultiply(result);
+            }
+        }
+
+        if (progress)
+            *progress += end - begin;
+    });
+}
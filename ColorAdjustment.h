@@ -0,0 +1,40 @@
+#ifndef COLORADJUSTMENT_H
+#define COLORADJUSTMENT_H
+
+#include <QImage>
+#include <QVector>
+#include <atomic>
+
+// Цветовая коррекция, заранее сведенная в таблицы: по 256 значений на канал
+// либо небольшая сетка RGB -> RGB для оттенка и насыщенности.
+// Таблицы работают с цветом без premultiply; прозрачность не меняется.
+class ColorAdjustment
+{
+public:
+    ColorAdjustment();
+
+    // Уровни: [inBlack, inWhite] растягивается на [outBlack, outWhite] с гаммой gamma
+    static ColorAdjustment levels(int inBlack, int inWhite, qreal gamma, int outBlack, int outWhite);
+    // Кривая через (0, 0), (64, shadows), (128, midtones), (192, highlights), (255, 255)
+    static ColorAdjustment curves(int shadows, int midtones, int highlights);
+    // hue в градусах, saturation и lightness в процентах -100..100
+    static ColorAdjustment hueSaturation(int hue, int saturation, int lightness);
+    static ColorAdjustment invert();
+
+    bool isIdentity() const { return m_identity; }
+
+    // Применяет коррекцию к rect изображения (Format_ARGB32_Premultiplied) в пуле потоков.
+    // progress увеличивается на число готовых строк; cancel прерывает работу между полосами
+    void apply(QImage& image, const QRect& rect,
+               std::atomic<int>* progress = nullptr, const std::atomic<bool>* cancel = nullptr) const;
+
+private:
+    QRgb lookupCube(QRgb color) const;
+
+    bool m_identity = true;
+    uchar m_lut[3][256];        // красный, зеленый, синий
+    int m_cubeSize = 0;         // 0 - сетки нет
+    QVector<QRgb> m_cube;       // m_cubeSize^3 узлов, индекс (r * size + g) * size + b
+};
+
+#endif // COLORADJUSTMENT_H
@@ -1,7 +1,9 @@
 // LayerCommands.cpp
 #include "Commands.h"
+#include "Parallel.h"
 #include "LayerManager.h"
 #include <qpainter.h>
+#include <cstring>
 
 
 AddLayerCommand::AddLayerCommand(LayerManager* manager,
@@ -22,6 +24,7 @@ void AddLayerCommand::Do()
     if (!layer) return;
 
     m_index = manager->layerCount() - 1;
+    m_layerId = layer->id();
 
     // Сохраняем параметры, чтобы Redo был корректным
     m_image = layer->image().copy();
@@ -35,20 +38,20 @@ void AddLayerCommand::Undo()
 {
     if (!manager || m_index < 0) return;
 
-    manager->removeLayer(m_index);
+    manager->removeLayer(manager->indexOf(m_layerId));
 }
 
 void AddLayerCommand::Redo()
 {
     if (!manager) return;
 
-    // создаём снова
-    Layer* newLayer = manager->createNewLayer(m_size, m_name);
-    if (!newLayer) return;
-
+    // создаём снова с прежним id, чтобы последующие команды нашли слой
+    auto newLayer = std::make_unique<Layer>(m_size, m_name);
+    newLayer->setId(m_layerId);
     newLayer->setImage(m_image.copy());
     newLayer->setOpacity(m_opacity);
     newLayer->setVisible(m_visibility);
+    manager->addLayer(std::move(newLayer));
 
     // index станет последним
     m_index = manager->layerCount() - 1;
@@ -57,20 +60,21 @@ void AddLayerCommand::Redo()
 }
 
 // DeleteLayerCommand
-DeleteLayerCommand::DeleteLayerCommand(LayerManager* manager, int layerIndex)
-    : manager(manager), layerIndex(layerIndex), wasActive(false)
+DeleteLayerCommand::DeleteLayerCommand(LayerManager* manager, LayerId layerId)
+    : manager(manager), layerIndex(-1), layerId(layerId), wasActive(false)
 {
-    if (manager && layerIndex >= 0 && layerIndex < manager->layerCount()) {
-        Layer* layer = manager->layerAt(layerIndex);
+    if (manager) {
+        Layer* layer = manager->layerById(layerId);
         if (layer) {
             // Сохраняем копию слоя
             deletedLayer = std::make_unique<Layer>(layer->image().size(), layer->name());
+            deletedLayer->setId(layer->id());
             deletedLayer->setImage(layer->image().copy());
             deletedLayer->setOpacity(layer->opacity());
             deletedLayer->setVisible(layer->isVisible());
 
             // Запоминаем, был ли это активный слой
-            wasActive = (manager->activeLayerIndex() == layerIndex);
+            wasActive = (manager->activeLayer() == layer);
         }
     }
 }
@@ -81,16 +85,19 @@ DeleteLayerCommand::~DeleteLayerCommand()
 
 void DeleteLayerCommand::Do()
 {
-    if (manager && layerIndex >= 0 && layerIndex < manager->layerCount()) {
+    if (manager) {
+        // Позиция для отмены берется в момент удаления
+        layerIndex = manager->indexOf(layerId);
         manager->removeLayer(layerIndex);
     }
 }
 
 void DeleteLayerCommand::Undo()
 {
-    if (manager && deletedLayer) {
+    if (manager && deletedLayer && layerIndex >= 0) {
         // Вставляем сохраненный слой обратно
         auto layer = std::make_unique<Layer>(deletedLayer->image().size(), deletedLayer->name());
+        layer->setId(deletedLayer->id());
         layer->setImage(deletedLayer->image().copy());
         layer->setOpacity(deletedLayer->opacity());
         layer->setVisible(deletedLayer->isVisible());
@@ -111,21 +118,25 @@ void DeleteLayerCommand::Redo()
 
 // MoveLayerCommand
 MoveLayerCommand::MoveLayerCommand(LayerManager* manager, int fromIndex, int toIndex)
-    : manager(manager), fromIndex(fromIndex), toIndex(toIndex)
+    : manager(manager), layerId(0), fromIndex(fromIndex), toIndex(toIndex)
 {
+    if (manager) {
+        if (const Layer* layer = manager->layerAt(fromIndex))
+            layerId = layer->id();
+    }
 }
 
 void MoveLayerCommand::Do()
 {
     if (manager) {
-        manager->moveLayer(fromIndex, toIndex);
+        manager->moveLayer(manager->indexOf(layerId), toIndex);
     }
 }
 
 void MoveLayerCommand::Undo()
 {
     if (manager) {
-        manager->moveLayer(toIndex, fromIndex);
+        manager->moveLayer(manager->indexOf(layerId), fromIndex);
     }
 }
 
@@ -135,11 +146,11 @@ void MoveLayerCommand::Redo()
 }
 
 // ToggleLayerVisibilityCommand
-ToggleLayerVisibilityCommand::ToggleLayerVisibilityCommand(LayerManager* manager, int layerIndex)
-    : manager(manager), layerIndex(layerIndex), oldVisibility(true)
+ToggleLayerVisibilityCommand::ToggleLayerVisibilityCommand(LayerManager* manager, LayerId layerId)
+    : manager(manager), layerId(layerId), oldVisibility(true)
 {
     if (manager) {
-        Layer* layer = manager->layerAt(layerIndex);
+        Layer* layer = manager->layerById(layerId);
         if (layer) {
             oldVisibility = layer->isVisible();
         }
@@ -149,10 +160,9 @@ ToggleLayerVisibilityCommand::ToggleLayerVisibilityCommand(LayerManager* manager
 void ToggleLayerVisibilityCommand::Do()
 {
     if (manager) {
-        Layer* layer = manager->layerAt(layerIndex);
+        Layer* layer = manager->layerById(layerId);
         if (layer) {
-            layer->setVisible(!layer->isVisible());
-            manager->layersChanged();
+            manager->setLayerVisible(manager->indexOf(layerId), !layer->isVisible());
         }
     }
 }
@@ -160,11 +170,7 @@ void ToggleLayerVisibilityCommand::Do()
 void ToggleLayerVisibilityCommand::Undo()
 {
     if (manager) {
-        Layer* layer = manager->layerAt(layerIndex);
-        if (layer) {
-            layer->setVisible(oldVisibility);
-            manager->layersChanged();
-        }
+        manager->setLayerVisible(manager->indexOf(layerId), oldVisibility);
     }
 }
 
@@ -174,9 +180,9 @@ void ToggleLayerVisibilityCommand::Redo()
 }
 
 // ChangeLayerOpacityCommand
-ChangeLayerOpacityCommand::    ChangeLayerOpacityCommand(LayerManager* m, int layerIndex, float oldOpacity, float newOpacity)
+ChangeLayerOpacityCommand::    ChangeLayerOpacityCommand(LayerManager* m, LayerId layerId, float oldOpacity, float newOpacity)
     : manager(m)
-    , layerIndex(layerIndex)
+    , layerId(layerId)
     , oldOpacity(oldOpacity)
     , newOpacity(newOpacity)
 {}
@@ -184,22 +190,14 @@ ChangeLayerOpacityCommand::    ChangeLayerOpacityCommand(LayerManager* m, int la
 void ChangeLayerOpacityCommand::Do()
 {
     if (manager) {
-        Layer* layer = manager->layerAt(layerIndex);
-        if (layer) {
-            layer->setOpacity(newOpacity);
-            manager->layersChanged();
-        }
+        manager->setLayerOpacity(manager->indexOf(layerId), newOpacity);
     }
 }
 
 void ChangeLayerOpacityCommand::Undo()
 {
     if (manager) {
-        Layer* layer = manager->layerAt(layerIndex);
-        if (layer) {
-            layer->setOpacity(oldOpacity);
-            manager->layersChanged();
-        }
+        manager->setLayerOpacity(manager->indexOf(layerId), oldOpacity);
     }
 }
 
@@ -209,36 +207,77 @@ void ChangeLayerOpacityCommand::Redo()
 }
 
 
-DrawCommand::DrawCommand(LayerManager* manager, int layerIndex, const QImage& before, const QImage& after)
+DrawCommand::DrawCommand(LayerManager* manager, LayerId layerId, const QImage& before, const QImage& after)
     : m_layerManager(manager)
-    , m_layerIndex(layerIndex)
+    , m_layerId(layerId)
     , m_beforeImage(before)
     , m_afterImage(after)
 {
 }
 
+DrawCommand::DrawCommand(LayerManager* manager, LayerId layerId, const QVector<ImagePatch>& patches)
+    : m_layerManager(manager)
+    , m_layerId(layerId)
+    , m_patches(patches)
+{
+}
+
 void DrawCommand::Do()
 {
     if (!m_layerManager) return;
 
-    Layer* layer = m_layerManager->layerAt(m_layerIndex);
-    if (!layer) return;
+    if (!m_patches.isEmpty()) {
+        applyPatches(true);
+        return;
+    }
 
-    layer->setImage(m_afterImage);
-    m_layerManager->setActiveLayer(m_layerIndex);
-    m_layerManager->layersChanged();
+    int index = m_layerManager->indexOf(m_layerId);
+    if (index < 0) return;
+
+    m_layerManager->setLayerImage(index, m_afterImage);
+    m_layerManager->setActiveLayer(index);
 }
 
 void DrawCommand::Undo()
 {
     if (!m_layerManager) return;
 
-    Layer* layer = m_layerManager->layerAt(m_layerIndex);
+    if (!m_patches.isEmpty()) {
+        applyPatches(false);
+        return;
+    }
+
+    int index = m_layerManager->indexOf(m_layerId);
+    if (index < 0) return;
+
+    m_layerManager->setLayerImage(index, m_beforeImage);
+    m_layerManager->setActiveLayer(index);
+}
+
+void DrawCommand::applyPatches(bool after)
+{
+    int index = m_layerManager->indexOf(m_layerId);
+    Layer* layer = m_layerManager->layerAt(index);
     if (!layer) return;
 
-    layer->setImage(m_beforeImage);
-    m_layerManager->setActiveLayer(m_layerIndex);
-    m_layerManager->layersChanged();
+    LayerManager::BatchScope batch(m_layerManager);
+    QImage& image = layer->image();
+    for (const ImagePatch& patch : m_patches) {
+        const QImage& source = after ? patch.after : patch.before;
+        const QRect rect = QRect(patch.offset, source.size()) & image.rect();
+        if (rect.isEmpty())
+            continue;
+
+        // Построчное копирование: формат участка и слоя совпадает
+        const qsizetype bytes = qsizetype(rect.width()) * 4;
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            memcpy(image.scanLine(y) + rect.left() * 4,
+                   source.constScanLine(y - patch.offset.y()) + (rect.left() - patch.offset.x()) * 4,
+                   bytes);
+        }
+        m_layerManager->notifyPixelsChanged(index, rect);
+    }
+    m_layerManager->setActiveLayer(index);
 }
 
 void DrawCommand::Redo()
@@ -246,10 +285,175 @@ void DrawCommand::Redo()
     Do();
 }
 
-RenameLayerCommand::RenameLayerCommand(LayerManager* manager, int index,
+ReplaceLayerImagesCommand::ReplaceLayerImagesCommand(LayerManager* manager, const QHash<LayerId, QImage>& before,
+                                                     const QHash<LayerId, QImage>& after)
+    : m_manager(manager)
+    , m_before(before)
+    , m_after(after)
+{
+}
+
+void ReplaceLayerImagesCommand::Do()
+{
+    if (m_manager)
+        m_manager->replaceLayerImages(m_after);
+}
+
+void ReplaceLayerImagesCommand::Undo()
+{
+    if (m_manager)
+        m_manager->replaceLayerImages(m_before);
+}
+
+void ReplaceLayerImagesCommand::Redo()
+{
+    Do();
+}
+
+OrientLayersCommand::OrientLayersCommand(LayerManager* manager, const QVector<LayerId>& layers, Orientation orientation)
+    : m_manager(manager)
+    , m_layers(layers)
+    , m_orientation(orientation)
+{
+}
+
+void OrientLayersCommand::Do()
+{
+    apply(m_orientation);
+}
+
+void OrientLayersCommand::Undo()
+{
+    apply(ImageOrientation::inverse(m_orientation));
+}
+
+void OrientLayersCommand::Redo()
+{
+    Do();
+}
+
+void OrientLayersCommand::apply(Orientation orientation)
+{
+    if (!m_manager) return;
+
+    QVector<Layer*> layers;
+    for (LayerId id : m_layers) {
+        if (Layer* layer = m_manager->layerById(id))
+            layers.append(layer);
+    }
+    if (layers.isEmpty()) return;
+
+    // Слои обрабатываются одновременно, прямо в своих изображениях
+    Parallel::forRanges(layers.size(), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            ImageOrientation::apply(layers[i]->image(), orientation);
+    });
+
+    if (ImageOrientation::swapsSize(orientation)) {
+        // Холст сменил размер: виды и выделение перестраиваются как при смене размера
+        QHash<LayerId, QImage> images;
+        for (Layer* layer : layers)
+            images.insert(layer->id(), layer->image());
+        m_manager->replaceLayerImages(images);
+        return;
+    }
+
+    LayerManager::BatchScope batch(m_manager);
+    for (Layer* layer : layers)
+        m_manager->notifyPixelsChanged(m_manager->indexOf(layer->id()));
+}
+
+CropCommand::CropCommand(LayerManager* manager, const QRect& rect)
+    : m_manager(manager)
+    , m_rect(rect)
+{
+}
+
+void CropCommand::Do()
+{
+    if (!m_manager || m_manager->layerCount() == 0) return;
+
+    m_canvasSize = m_manager->layerAt(0)->image().size();
+    const QRect rect = m_rect & QRect(QPoint(0, 0), m_canvasSize);
+    if (rect.isEmpty() || rect.size() == m_canvasSize) return;
+
+    const int count = m_manager->layerCount();
+    QVector<const Layer*> layers(count);
+    QVector<QImage> kept(count);
+    for (int i = 0; i < count; ++i)
+        layers[i] = m_manager->layerAt(i);
+    m_margins.resize(count);
+
+    // Середина и поля копируются построчно (QImage::copy), слои - параллельно
+    Parallel::forRanges(count, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const QImage& image = layers[i]->image();
+            const int width = image.width();
+            Margins& margins = m_margins[i];
+            margins.layerId = layers[i]->id();
+            margins.top = image.copy(0, 0, width, rect.top());
+            margins.bottom = image.copy(0, rect.bottom() + 1, width, image.height() - rect.bottom() - 1);
+            margins.left = image.copy(0, rect.top(), rect.left(), rect.height());
+            margins.right = image.copy(rect.right() + 1, rect.top(), width - rect.right() - 1, rect.height());
+            kept[i] = image.copy(rect);
+        }
+    });
+
+    // Прежние изображения освобождаются здесь, если на них больше никто не ссылается
+    QHash<LayerId, QImage> images;
+    for (int i = 0; i < count; ++i)
+        images.insert(m_margins[i].layerId, kept[i]);
+    m_manager->replaceLayerImages(images);
+}
+
+void CropCommand::Undo()
+{
+    if (!m_manager || m_margins.isEmpty()) return;
+
+    const QRect rect = m_rect & QRect(QPoint(0, 0), m_canvasSize);
+    QVector<QImage> restored(m_margins.size());
+
+    auto place = [](QImage& target, const QImage& part, int x, int y) {
+        const qsizetype bytes = qsizetype(part.width()) * 4;
+        for (int row = 0; row < part.height(); ++row)
+            memcpy(target.scanLine(y + row) + x * 4, part.constScanLine(row), bytes);
+    };
+
+    Parallel::forRanges(m_margins.size(), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const Margins& margins = m_margins[i];
+            const Layer* layer = m_manager->layerById(margins.layerId);
+            if (!layer || layer->image().size() != rect.size())
+                continue;
+
+            QImage full(m_canvasSize, QImage::Format_ARGB32_Premultiplied);
+            place(full, margins.top, 0, 0);
+            place(full, margins.left, 0, rect.top());
+            place(full, layer->image(), rect.left(), rect.top());
+            place(full, margins.right, rect.right() + 1, rect.top());
+            place(full, margins.bottom, 0, rect.bottom() + 1);
+            restored[i] = full;
+        }
+    });
+
+    QHash<LayerId, QImage> images;
+    for (int i = 0; i < m_margins.size(); ++i) {
+        if (!restored[i].isNull())
+            images.insert(m_margins[i].layerId, restored[i]);
+    }
+    m_margins.clear();
+    m_manager->replaceLayerImages(images);
+}
+
+void CropCommand::Redo()
+{
+    Do();
+}
+
+RenameLayerCommand::RenameLayerCommand(LayerManager* manager, LayerId layerId,
                                        const QString& oldName, const QString& newName)
     : m_manager(manager)
-    , m_index(index)
+    , m_layerId(layerId)
     , m_oldName(oldName)
     , m_newName(newName)
 {
@@ -264,30 +468,24 @@ void RenameLayerCommand::Undo()
 {
     if (!m_manager) return;
 
-    Layer* layer = m_manager->layerAt(m_index);
-    if (!layer) return;
-
-    layer->setName(m_oldName);
-    m_manager->layersChanged();
+    m_manager->setLayerName(m_manager->indexOf(m_layerId), m_oldName);
 }
 
 void RenameLayerCommand::Redo()
 {
     if (!m_manager) return;
 
-    Layer* layer = m_manager->layerAt(m_index);
-    if (!layer) return;
-
-    layer->setName(m_newName);
-    m_manager->layersChanged();
+    m_manager->setLayerName(m_manager->indexOf(m_layerId), m_newName);
 }
 
-MergeLayerWithNextCommand::MergeLayerWithNextCommand(LayerManager* manager, int topIndex)
+MergeLayerWithNextCommand::MergeLayerWithNextCommand(LayerManager* manager, LayerId topId)
     : m_manager(manager)
-    , m_topIndex(topIndex)
-    , m_topBackup(*m_manager->layerAt(topIndex))
-    , m_bottomBackup(*m_manager->layerAt(topIndex - 1))
+    , m_topId(topId)
+    , m_bottomId(0)
+    , m_topBackup(*m_manager->layerById(topId))
+    , m_bottomBackup(*m_manager->layerAt(m_manager->indexOf(topId) - 1))
 {
+    m_bottomId = m_bottomBackup.id();
 }
 
 void MergeLayerWithNextCommand::Do()
@@ -299,56 +497,60 @@ void MergeLayerWithNextCommand::Redo()
 {
     if (!m_manager) return;
 
-    int bottomIndex = m_topIndex - 1;
-    if (bottomIndex < 0) return;
+    int topIndex = m_manager->indexOf(m_topId);
+    int bottomIndex = m_manager->indexOf(m_bottomId);
+    if (topIndex < 0 || bottomIndex < 0) return;
 
-    Layer* top = m_manager->layerAt(m_topIndex);
+    Layer* top = m_manager->layerAt(topIndex);
     Layer* bottom = m_manager->layerAt(bottomIndex);
     if (!top || !bottom) return;
 
+    LayerManager::BatchScope batch(m_manager);
+
     // Рисуем верхний слой поверх нижнего
     QPainter p(&bottom->image());
     p.setOpacity(top->opacity());
     p.drawImage(0, 0, top->image());
     p.end();
+    m_manager->notifyPixelsChanged(bottomIndex);
 
     // Удаляем верхний слой
-    m_manager->removeLayer(m_topIndex);
-
-    // Обновляем UI
-    m_manager->layersChanged();
+    m_manager->removeLayer(topIndex);
 }
 
 void MergeLayerWithNextCommand::Undo()
 {
     if (!m_manager) return;
 
-    // Удаляем объединённый слой (на позиции верхнего)
-    m_manager->removeLayer(m_topIndex - 1);
+    // Объединённый слой сохранил id нижнего
+    int bottomIndex = m_manager->indexOf(m_bottomId);
+    if (bottomIndex < 0) return;
 
-    // Вставляем обратно исходные слои в правильном порядке
-    // Сначала нижний слой (м_topIndex - 1), потом верхний (м_topIndex)
-    m_manager->insertLayer(m_topIndex - 1, std::make_unique<Layer>(m_bottomBackup));
-    m_manager->insertLayer(m_topIndex, std::make_unique<Layer>(m_topBackup));
+    LayerManager::BatchScope batch(m_manager);
 
-    // Восстанавливаем активный слой
-    m_manager->setActiveLayer(m_topIndex);
+    m_manager->removeLayer(bottomIndex);
+
+    // Вставляем обратно исходные слои с прежними id: сначала нижний, над ним верхний
+    m_manager->insertLayer(bottomIndex, std::make_unique<Layer>(m_bottomBackup));
+    m_manager->insertLayer(bottomIndex + 1, std::make_unique<Layer>(m_topBackup));
 
-    m_manager->layersChanged();
+    // Восстанавливаем активный слой
+    m_manager->setActiveLayer(m_manager->indexOf(m_topId));
 }
 
 
-DuplicateLayerCommand::DuplicateLayerCommand(LayerManager* manager, int layerIndex)
-    : m_manager(manager), m_sourceIndex(layerIndex), m_duplicateIndex(-1)
+DuplicateLayerCommand::DuplicateLayerCommand(LayerManager* manager, LayerId sourceId)
+    : m_manager(manager), m_sourceId(sourceId), m_duplicateId(0)
 {
 }
 
 void DuplicateLayerCommand::Do()
 {
-    if (!m_manager || m_sourceIndex < 0 || m_sourceIndex >= m_manager->layerCount())
+    if (!m_manager)
         return;
 
-    const Layer* sourceLayer = m_manager->layerAt(m_sourceIndex);
+    int sourceIndex = m_manager->indexOf(m_sourceId);
+    const Layer* sourceLayer = m_manager->layerAt(sourceIndex);
     if (!sourceLayer)
         return;
 
@@ -359,24 +561,27 @@ void DuplicateLayerCommand::Do()
     m_duplicatedLayer->setOpacity(sourceLayer->opacity());
     m_duplicatedLayer->setVisible(sourceLayer->isVisible());
 
-    // Вставляем слой сразу после исходного
-    m_duplicateIndex = m_sourceIndex + 1;
-    m_manager->insertLayer(m_duplicateIndex, std::move(m_duplicatedLayer));
+    // Вставляем слой сразу после исходного; id назначает менеджер
+    Layer* duplicate = m_duplicatedLayer.get();
+    m_manager->insertLayer(sourceIndex + 1, std::move(m_duplicatedLayer));
+    m_duplicateId = duplicate->id();
 }
 
 void DuplicateLayerCommand::Undo()
 {
-    if (!m_manager || m_duplicateIndex < 0 || m_duplicateIndex >= m_manager->layerCount())
+    if (!m_manager)
         return;
 
     // Перемещаем слой обратно в уникальный указатель для Redo
-    Layer* layer = m_manager->layerAt(m_duplicateIndex);
+    int duplicateIndex = m_manager->indexOf(m_duplicateId);
+    Layer* layer = m_manager->layerAt(duplicateIndex);
     if (layer) {
         m_duplicatedLayer = std::make_unique<Layer>(layer->image().size(), layer->name());
+        m_duplicatedLayer->setId(layer->id());
         m_duplicatedLayer->setImage(layer->image().copy());
         m_duplicatedLayer->setOpacity(layer->opacity());
         m_duplicatedLayer->setVisible(layer->isVisible());
-        m_manager->removeLayer(m_duplicateIndex);
+        m_manager->removeLayer(duplicateIndex);
     }
 }
 
@@ -385,6 +590,9 @@ void DuplicateLayerCommand::Redo()
     if (!m_manager || !m_duplicatedLayer)
         return;
 
-    // Вставляем слой обратно
-    m_manager->insertLayer(m_duplicateIndex, std::move(m_duplicatedLayer));
+    // Вставляем слой обратно над исходным, с прежним id
+    int sourceIndex = m_manager->indexOf(m_sourceId);
+    if (sourceIndex < 0)
+        return;
+    m_manager->insertLayer(sourceIndex + 1, std::move(m_duplicatedLayer));
 }
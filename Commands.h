@@ -4,8 +4,19 @@
 #include "CommandSystem.h"
 #include "Layer.h"
 #include <QList>
+#include <QVector>
 #include <QPointer>
+#include <QHash>
 #include "LayerManager.h"
+#include "ImageOrientation.h"
+
+// Участок слоя до и после изменения: история хранит его вместо целого слоя
+struct ImagePatch
+{
+    QPoint offset;
+    QImage before;
+    QImage after;
+};
 
 class AddLayerCommand : public Command
 {
@@ -25,6 +36,7 @@ private:
     QString m_name;
 
     int m_index;
+    LayerId m_layerId = 0;
 
     QImage m_image;
     float m_opacity;
@@ -34,7 +46,7 @@ private:
 class DeleteLayerCommand : public Command
 {
 public:
-    DeleteLayerCommand(LayerManager* manager, int layerIndex);
+    DeleteLayerCommand(LayerManager* manager, LayerId layerId);
     ~DeleteLayerCommand();
 
     void Do() override;
@@ -44,6 +56,7 @@ public:
 private:
     QPointer<LayerManager> manager;
     int layerIndex;
+    LayerId layerId;
     std::unique_ptr<Layer> deletedLayer;
     bool wasActive;
 };
@@ -59,6 +72,7 @@ public:
 
 private:
     QPointer<LayerManager> manager;
+    LayerId layerId;
     int fromIndex;
     int toIndex;
 };
@@ -66,7 +80,7 @@ private:
 class ToggleLayerVisibilityCommand : public Command
 {
 public:
-    ToggleLayerVisibilityCommand(LayerManager* manager, int layerIndex);
+    ToggleLayerVisibilityCommand(LayerManager* manager, LayerId layerId);
 
     void Do() override;
     void Undo() override;
@@ -74,14 +88,14 @@ public:
 
 private:
     QPointer<LayerManager> manager;
-    int layerIndex;
+    LayerId layerId;
     bool oldVisibility;
 };
 
 class ChangeLayerOpacityCommand : public Command
 {
 public:
-    ChangeLayerOpacityCommand(LayerManager* m, int layerIndex, float oldOpacity, float newOpacity);
+    ChangeLayerOpacityCommand(LayerManager* m, LayerId layerId, float oldOpacity, float newOpacity);
 
     void Do() override;
     void Undo() override;
@@ -89,7 +103,7 @@ public:
 
 private:
     QPointer<LayerManager> manager;
-    int layerIndex;
+    LayerId layerId;
     float newOpacity;
     float oldOpacity;
 };
@@ -97,7 +111,7 @@ private:
 class DuplicateLayerCommand : public Command
 {
 public:
-    DuplicateLayerCommand(LayerManager* manager, int layerIndex);
+    DuplicateLayerCommand(LayerManager* manager, LayerId sourceId);
 
     void Do() override;
     void Undo() override;
@@ -105,31 +119,99 @@ public:
 
 private:
     QPointer<LayerManager> m_manager;
-    int m_sourceIndex;
+    LayerId m_sourceId;
     std::unique_ptr<Layer> m_duplicatedLayer;
-    int m_duplicateIndex;
+    LayerId m_duplicateId;
 };
 
 class DrawCommand : public Command
 {
 public:
-    DrawCommand(LayerManager* manager, int layerIndex, const QImage& before, const QImage& after);
+    DrawCommand(LayerManager* manager, LayerId layerId, const QImage& before, const QImage& after);
+    // Изменены только участки слоя
+    DrawCommand(LayerManager* manager, LayerId layerId, const QVector<ImagePatch>& patches);
 
     void Do() override;
     void Undo() override;
     void Redo() override;
 
 private:
+    void applyPatches(bool after);
+
     LayerManager* m_layerManager;
-    int m_layerIndex;
+    LayerId m_layerId;
     QImage m_beforeImage;
     QImage m_afterImage;
+    QVector<ImagePatch> m_patches;
+};
+
+// Все слои сразу: размер изображения или холста. Хранит слои целиком до и после
+class ReplaceLayerImagesCommand : public Command
+{
+public:
+    ReplaceLayerImagesCommand(LayerManager* manager, const QHash<LayerId, QImage>& before,
+                              const QHash<LayerId, QImage>& after);
+
+    void Do() override;
+    void Undo() override;
+    void Redo() override;
+
+private:
+    QPointer<LayerManager> m_manager;
+    QHash<LayerId, QImage> m_before;
+    QHash<LayerId, QImage> m_after;
+};
+
+// Поворот или отражение слоев. Операция обратима сама по себе, поэтому
+// команда не хранит пикселей: отмена применяет обратную операцию
+class OrientLayersCommand : public Command
+{
+public:
+    OrientLayersCommand(LayerManager* manager, const QVector<LayerId>& layers, Orientation orientation);
+
+    void Do() override;
+    void Undo() override;
+    void Redo() override;
+
+private:
+    void apply(Orientation orientation);
+
+    QPointer<LayerManager> m_manager;
+    QVector<LayerId> m_layers;
+    Orientation m_orientation;
+};
+
+// Обрезка холста до rect. Отмена хранит только отрезанные поля каждого слоя:
+// при возврате слой собирается из полей и оставшейся середины
+class CropCommand : public Command
+{
+public:
+    CropCommand(LayerManager* manager, const QRect& rect);
+
+    void Do() override;
+    void Undo() override;
+    void Redo() override;
+
+private:
+    struct Margins
+    {
+        LayerId layerId = 0;
+        QImage top;     // вся ширина над rect
+        QImage bottom;  // вся ширина под rect
+        QImage left;    // высота rect слева
+        QImage right;   // высота rect справа
+    };
+
+    QPointer<LayerManager> m_manager;
+    QRect m_rect;
+    QSize m_canvasSize;
+    QVector<Margins> m_margins;
 };
 
 class RenameLayerCommand : public Command
 {
 public:
-    RenameLayerCommand(LayerManager* manager, int index,
+    RenameLayerCommand(LayerManager* manager, LayerId layerId,
                        const QString& oldName, const QString& newName);
 
     void Do() override;
@@ -138,7 +220,7 @@ public:
 
 private:
     LayerManager* m_manager;
-    int m_index;
+    LayerId m_layerId;
     QString m_oldName;
     QString m_newName;
 };
@@ -147,7 +229,7 @@ private:
 class MergeLayerWithNextCommand : public Command
 {
 public:
-    MergeLayerWithNextCommand(LayerManager* manager, int topIndex);
+    MergeLayerWithNextCommand(LayerManager* manager, LayerId topId);
 
     void Do() override;
     void Undo() override;
@@ -155,7 +237,8 @@ public:
 
 private:
     LayerManager* m_manager;
-    int m_topIndex;
+    LayerId m_topId;
+    LayerId m_bottomId;
 
     Layer m_topBackup;
     Layer m_bottomBackup;
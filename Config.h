@@ -9,6 +9,51 @@
 #define MAX_STACK_SIZE 20
 #define CHECK_COLOR_1 QColor(200,200,200)
 #define CHECK_COLOR_2 QColor(150,150,150)
+#define FILL_HOVER_COLOR QColor(0, 120, 215, 90)
+#define STROKE_FLUSH_INTERVAL_MS 4
+
+// Прогноз штриха: рисуется поверх холста и не попадает в слой
+#define STROKE_PREDICTION_ENABLED true
+#define STROKE_PREDICTION_SAMPLES 4
+#define STROKE_PREDICTION_HORIZON_MS 16
+#define STROKE_PREDICTION_MAX_DISTANCE 40.0
+#define SHOW_INPUT_LATENCY false
+
+// Сглаживание штриха кривой Катмулла-Рома
+#define STROKE_CURVE_TOLERANCE 0.25      // допустимое отклонение хорды от кривой, px
+#define STROKE_MIN_SAMPLE_DISTANCE 0.5   // более близкие отсчеты не становятся узлами
+
+// Плитки, на которые делится слой при параллельной обработке и в истории
+#define IMAGE_TILE_SIZE 64
+
+// Карандаш до этого размера рисуется по пикселям (Брезенхэм), без QPainter
+#define PENCIL_PIXEL_MAX_SIZE 3
+
+// Мягкая кисть из отпечатков
+#define BRUSH_HARDNESS 0.0          // 0 - прежний мягкий спад, 1 - жесткий край
+#define BRUSH_DAB_SPACING 0.1       // шаг между отпечатками в долях диаметра
+#define BRUSH_DAB_MIN_SPACING 0.5   // px
+#define BRUSH_DAB_CACHE_LIMIT 512
+
+// "Бегущие муравьи" вокруг выделения
+#define SELECTION_ANTS_INTERVAL_MS 200
+#define SELECTION_ANTS_DASH 4
+
+// Трансформация: предпросмотр из копии не больше этого размера, ручки на углах рамки
+#define TRANSFORM_PROXY_SIZE 1024
+#define TRANSFORM_HANDLE_SIZE 8     // px
+
+// Фильтры слоя
+#define FILTER_GAUSSIAN_EXACT_RADIUS 3.0   // больше - приближение тремя скользящими средними
+#define FILTER_MAX_RADIUS 250
+
+// Цветокоррекция
+#define COLOR_CUBE_SIZE 17              // узлов сетки на канал для оттенка/насыщенности
+#define ADJUSTMENT_PROGRESS_INTERVAL_MS 50
+
+// Градиент
+#define GRADIENT_RAMP_SIZE 1024     // записей в таблице цветов
+#define GRADIENT_PREVIEW_SIZE 512   // предпросмотр считается не крупнее этого
 
 //----------------Стартовое меню-------------------------------
 #define MIN_CANVAS_SIZE 1
@@ -108,6 +153,11 @@
 #define LAYER_ITEM_OPACITY_LABEL_FONT_SIZE 10
 #define LAYER_ITEM_OPACITY_LABEL_COLOR "#666"
 
+#define LAYER_ITEM_HEIGHT 36
+#define LAYER_THUMBNAIL_WIDTH 40
+#define LAYER_THUMBNAIL_HEIGHT 30
+#define LAYER_THUMBNAIL_UPDATE_MS 200
+
 // Слайдер прозрачности
 #define LAYER_OPACITY_LABEL_WIDTH 50
 #define LAYER_OPACITY_SLIDER_MIN 0
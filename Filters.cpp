@@ -0,0 +1,320 @@
+#include "Filters.h"
+#include "Parallel.h"
+#include "Config.h"
+#include <QVector>
+#include <QtMath>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// Все проходы считают по байтам: четыре канала пикселя подряд, поэтому
+// внутренние циклы - сплошные массивы, которые компилятор векторизует
+
+// Строка с повторенными крайними пикселями: left слева и right справа
+void padRow(const uchar* line, int width, int left, int right, quint32* out)
+{
+    const quint32* pixels = reinterpret_cast<const quint32*>(line);
+    std::fill(out, out + left, pixels[0]);
+    std::memcpy(out + left, pixels, size_t(width) * 4);
+    std::fill(out + left + width, out + left + width + right, pixels[width - 1]);
+}
+
+// Веса ядра в 1/65536, сумма ровно 65536
+QVector<quint32> gaussianKernel(qreal sigma)
+{
+    const int radius = qMax(1, qCeil(sigma * 3.0));
+    QVector<double> weights(2 * radius + 1);
+    double total = 0.0;
+    for (int i = -radius; i <= radius; ++i) {
+        weights[i + radius] = qExp(-(i * i) / (2.0 * sigma * sigma));
+        total += weights[i + radius];
+    }
+
+    QVector<quint32> kernel(weights.size());
+    quint32 sum = 0;
+    for (int i = 0; i < weights.size(); ++i) {
+        kernel[i] = quint32(qRound(weights[i] / total * 65536.0));
+        sum += kernel[i];
+    }
+    kernel[radius] += 65536 - sum;
+    return kernel;
+}
+
+// Радиусы трех скользящих средних с той же дисперсией, что у гауссиана sigma
+QVector<int> boxRadii(qreal sigma)
+{
+    const int passes = 3;
+    const double ideal = qSqrt(12.0 * sigma * sigma / passes + 1.0);
+    int lower = int(ideal);
+    if (lower % 2 == 0)
+        --lower;
+    const int upper = lower + 2;
+    const int lowerCount = qRound((12.0 * sigma * sigma - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes)
+                                  / (-4.0 * lower - 4.0));
+
+    QVector<int> radii;
+    for (int i = 0; i < passes; ++i)
+        radii.append(((i < lowerCount ? lower : upper) - 1) / 2);
+    return radii;
+}
+
+void convolveRows(QImage& image, const QVector<quint32>& kernel)
+{
+    const int radius = kernel.size() / 2;
+    const int width = image.width();
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    Parallel::forRanges(image.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+        QVector<quint32> padded(width + 2 * radius);
+        QVector<quint32> acc(width * 4);
+        const uchar* source = reinterpret_cast<const uchar*>(padded.constData());
+
+        for (int y = begin; y < end; ++y) {
+            uchar* line = bits + y * stride;
+            padRow(line, width, radius, radius, padded.data());
+            std::fill(acc.begin(), acc.end(), 0x8000);
+            for (int t = 0; t < kernel.size(); ++t) {
+                const quint32 weight = kernel[t];
+                const uchar* src = source + t * 4;
+                quint32* dst = acc.data();
+                for (int i = 0; i < width * 4; ++i)
+                    dst[i] += src[i] * weight;
+            }
+            for (int i = 0; i < width * 4; ++i)
+                line[i] = uchar(acc[i] >> 16);
+        }
+    });
+}
+
+void convolveColumns(QImage& image, const QVector<quint32>& kernel)
+{
+    const QImage source = image.copy();
+    const int radius = kernel.size() / 2;
+    const int width = image.width();
+    const int height = image.height();
+    const uchar* sourceBits = source.constBits();
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    // Блоки плиток: строки ядра, общие для соседних выходных строк, остаются в кэше
+    const int columns = (width + IMAGE_TILE_SIZE - 1) / IMAGE_TILE_SIZE;
+    const int bands = (height + IMAGE_TILE_SIZE - 1) / IMAGE_TILE_SIZE;
+    Parallel::forRanges(columns * bands, 1, [&](int begin, int end) {
+        QVector<quint32> acc(IMAGE_TILE_SIZE * 4);
+        for (int block = begin; block < end; ++block) {
+            const int x0 = (block % columns) * IMAGE_TILE_SIZE;
+            const int y0 = (block / columns) * IMAGE_TILE_SIZE;
+            const int count = (qMin(width, x0 + IMAGE_TILE_SIZE) - x0) * 4;
+            const int y1 = qMin(height, y0 + IMAGE_TILE_SIZE);
+
+            for (int y = y0; y < y1; ++y) {
+                std::fill(acc.begin(), acc.begin() + count, 0x8000);
+                for (int t = 0; t < kernel.size(); ++t) {
+                    const quint32 weight = kernel[t];
+                    const uchar* src = sourceBits + qBound(0, y + t - radius, height - 1) * stride + x0 * 4;
+                    quint32* dst = acc.data();
+                    for (int i = 0; i < count; ++i)
+                        dst[i] += src[i] * weight;
+                }
+                uchar* line = bits + y * stride + x0 * 4;
+                for (int i = 0; i < count; ++i)
+                    line[i] = uchar(acc[i] >> 16);
+            }
+        }
+    });
+}
+
+// Скользящее среднее: окно сдвигается добавлением входящего и вычитанием уходящего
+void boxRows(QImage& image, int radius)
+{
+    const int width = image.width();
+    const int window = 2 * radius + 1;
+    const quint32 scale = (1u << 24) / window;
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    Parallel::forRanges(image.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+        QVector<quint32> padded(width + 2 * radius + 1);
+        const uchar* source = reinterpret_cast<const uchar*>(padded.constData());
+
+        for (int y = begin; y < end; ++y) {
+            uchar* line = bits + y * stride;
+            padRow(line, width, radius, radius + 1, padded.data());
+            for (int c = 0; c < 4; ++c) {
+                quint32 sum = 0;
+                for (int i = 0; i < window; ++i)
+                    sum += source[i * 4 + c];
+                for (int x = 0; x < width; ++x) {
+                    line[x * 4 + c] = uchar((sum * scale + (1u << 23)) >> 24);
+                    sum += source[(x + window) * 4 + c] - source[x * 4 + c];
+                }
+            }
+        }
+    });
+}
+
+void boxColumns(QImage& image, int radius)
+{
+    const QImage source = image.copy();
+    const int width = image.width();
+    const int height = image.height();
+    const quint32 scale = (1u << 24) / (2 * radius + 1);
+    const uchar* sourceBits = source.constBits();
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+    auto row = [&](int y) { return sourceBits + qBound(0, y, height - 1) * stride; };
+
+    // Сумма идет вниз по столбцам, поэтому параллельно - только полосы столбцов
+    const int columns = (width + IMAGE_TILE_SIZE - 1) / IMAGE_TILE_SIZE;
+    Parallel::forRanges(columns, 1, [&](int begin, int end) {
+        QVector<quint32> acc(IMAGE_TILE_SIZE * 4);
+        for (int block = begin; block < end; ++block) {
+            const int x0 = block * IMAGE_TILE_SIZE;
+            const int count = (qMin(width, x0 + IMAGE_TILE_SIZE) - x0) * 4;
+            quint32* sum = acc.data();
+
+            std::fill(acc.begin(), acc.end(), 0);
+            for (int y = -radius; y <= radius; ++y) {
+                const uchar* src = row(y) + x0 * 4;
+                for (int i = 0; i < count; ++i)
+                    sum[i] += src[i];
+            }
+
+            for (int y = 0; y < height; ++y) {
+                uchar* line = bits + y * stride + x0 * 4;
+                for (int i = 0; i < count; ++i)
+                    line[i] = uchar((sum[i] * scale + (1u << 23)) >> 24);
+
+                const uchar* incoming = row(y + radius + 1) + x0 * 4;
+                const uchar* outgoing = row(y - radius) + x0 * 4;
+                for (int i = 0; i < count; ++i)
+                    sum[i] += incoming[i] - outgoing[i];
+            }
+        }
+    });
+}
+
+}
+
+namespace Filters
+{
+
+void gaussianBlur(QImage& image, qreal radius)
+{
+    if (radius <= 0.0 || image.isNull())
+        return;
+
+    if (radius <= FILTER_GAUSSIAN_EXACT_RADIUS) {
+        const QVector<quint32> kernel = gaussianKernel(radius);
+        convolveRows(image, kernel);
+        convolveColumns(image, kernel);
+        return;
+    }
+
+    const QVector<int> radii = boxRadii(radius);
+    for (int r : radii)
+        boxRows(image, r);
+    for (int r : radii)
+        boxColumns(image, r);
+}
+
+int gaussianReach(qreal radius)
+{
+    return qCeil(radius * 3.0) + 1;
+}
+
+void boxBlur(QImage& image, int radius)
+{
+    if (radius <= 0 || image.isNull())
+        return;
+
+    boxRows(image, radius);
+    boxColumns(image, radius);
+}
+
+void unsharpMask(QImage& image, qreal radius, qreal amount, int threshold)
+{
+    if (radius <= 0.0 || amount <= 0.0 || image.isNull())
+        return;
+
+    QImage blurred = image.copy();
+    gaussianBlur(blurred, radius);
+
+    const int gain = qRound(amount * 256.0);
+    const int width = image.width();
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    Parallel::forRanges(image.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(bits + y * stride);
+            const QRgb* soft = reinterpret_cast<const QRgb*>(blurred.constScanLine(y));
+            for (int x = 0; x < width; ++x) {
+                const int alpha = qAlpha(line[x]);
+                // Цвет premultiplied, поэтому не может превышать прозрачность
+                auto sharpen = [&](int value, int smooth) {
+                    const int diff = value - smooth;
+                    if (qAbs(diff) < threshold)
+                        return value;
+                    return qBound(0, value + diff * gain / 256, alpha);
+                };
+                line[x] = qRgba(sharpen(qRed(line[x]), qRed(soft[x])),
+                                sharpen(qGreen(line[x]), qGreen(soft[x])),
+                                sharpen(qBlue(line[x]), qBlue(soft[x])),
+                                alpha);
+            }
+        }
+    });
+}
+
+void motionBlur(QImage& image, int length, qreal angle)
+{
+    if (length <= 1 || image.isNull())
+        return;
+
+    // Отсчеты вдоль отрезка с центром в пикселе
+    const qreal radians = qDegreesToRadians(angle);
+    QVector<QPoint> taps;
+    for (int i = 0; i < length; ++i) {
+        const qreal t = i - (length - 1) / 2.0;
+        taps.append(QPoint(qRound(t * qCos(radians)), qRound(t * qSin(radians))));
+    }
+
+    const QImage source = image.copy();
+    const int width = image.width();
+    const int height = image.height();
+    const quint32 scale = (1u << 24) / length;
+    const uchar* sourceBits = source.constBits();
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    Parallel::forRanges(height, IMAGE_TILE_SIZE, [&](int begin, int end) {
+        QVector<quint32> acc(width * 4);
+        for (int y = begin; y < end; ++y) {
+            std::fill(acc.begin(), acc.end(), 0);
+            for (const QPoint& tap : taps) {
+                const uchar* src = sourceBits + qBound(0, y + tap.y(), height - 1) * stride;
+                // Внутри строки - сплошной сдвиг, за краями - крайний пиксель
+                const int lo = qBound(0, -tap.x(), width);
+                const int hi = qBound(lo, width - tap.x(), width);
+                for (int i = 0; i < lo * 4; ++i)
+                    acc[i] += src[i % 4];
+                const int shift = tap.x() * 4;
+                for (int i = lo * 4; i < hi * 4; ++i)
+                    acc[i] += src[i + shift];
+                const uchar* last = src + (width - 1) * 4;
+                for (int i = hi * 4; i < width * 4; ++i)
+                    acc[i] += last[i % 4];
+            }
+
+            uchar* line = bits + y * stride;
+            for (int i = 0; i < width * 4; ++i)
+                line[i] = uchar((acc[i] * scale + (1u << 23)) >> 24);
+        }
+    });
+}
+
+}
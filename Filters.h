@@ -0,0 +1,29 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <QImage>
+
+// Фильтры слоя. Работают с Format_ARGB32_Premultiplied на месте; за краем
+// изображения повторяется крайний пиксель. Проходы делят изображение на полосы
+// строк (или столбцов) для пула потоков.
+namespace Filters
+{
+    // Размытие по Гауссу, radius - сигма в пикселях. Малые радиусы считаются
+    // точным ядром, большие - тремя скользящими средними (O(1) на пиксель)
+    void gaussianBlur(QImage& image, qreal radius);
+
+    // Среднее по квадрату (2 * radius + 1) x (2 * radius + 1)
+    void boxBlur(QImage& image, int radius);
+
+    // Нерезкая маска: к цвету добавляется amount разницы с размытой копией,
+    // если она не меньше threshold (0..255). Прозрачность не меняется
+    void unsharpMask(QImage& image, qreal radius, qreal amount, int threshold);
+
+    // Смаз вдоль направления angle (градусы) на length пикселей
+    void motionBlur(QImage& image, int length, qreal angle);
+
+    // Сколько пикселей вокруг области фильтр читает
+    int gaussianReach(qreal radius);
+}
+
+#endif // FILTERS_H
@@ -0,0 +1,327 @@
+#include "FloodFill.h"
+#include "Parallel.h"
+#include "Config.h"
+#include <QColor>
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace FloodFill
+{
+
+ToleranceBounds toleranceBounds(QRgb target, int tolerance)
+{
+    tolerance = qBound(0, tolerance, 255);
+    const int channels[4] = { qAlpha(target), qRed(target), qGreen(target), qBlue(target) };
+
+    ToleranceBounds bounds;
+    for (int i = 0; i < 4; ++i) {
+        const int lo = qMax(0, channels[i] - tolerance);
+        const int hi = qMin(255, channels[i] + tolerance);
+        bounds.lo[i] = uchar(lo);
+        bounds.range[i] = uchar(hi - lo);
+    }
+    return bounds;
+}
+
+namespace
+{
+    // Один бит на пиксель: пройден ли он уже
+    class VisitedMask
+    {
+    public:
+        VisitedMask(int width, int height)
+            : m_stride((width + 63) / 64)
+            , m_bits(qsizetype(m_stride) * height, 0)
+        {
+        }
+
+        bool test(int x, int y) const
+        {
+            return m_bits[qsizetype(y) * m_stride + (x >> 6)] & (quint64(1) << (x & 63));
+        }
+
+        void set(int x, int y)
+        {
+            m_bits[qsizetype(y) * m_stride + (x >> 6)] |= quint64(1) << (x & 63);
+        }
+
+    private:
+        int m_stride;
+        QVector<quint64> m_bits;
+    };
+}
+
+QRect growRegion(const QImage& image, const QPoint& seed,
+                 const ToleranceBounds& bounds, const SpanFunction& onSpan)
+{
+    const int width = image.width();
+    const int height = image.height();
+    if (seed.x() < 0 || seed.y() < 0 || seed.x() >= width || seed.y() >= height)
+        return QRect();
+
+    Q_ASSERT(image.format() == QImage::Format_ARGB32_Premultiplied);
+
+    VisitedMask visited(width, height);
+    const uchar* bits = image.constBits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+
+    // Сначала проверяется маска: пройденные пиксели onSpan мог уже перезаписать
+    auto open = [&](int x, int y) {
+        return !visited.test(x, y)
+            && bounds.contains(reinterpret_cast<const QRgb*>(bits + y * bytesPerLine)[x]);
+    };
+    auto take = [&](int y, int x0, int x1) {
+        for (int x = x0; x <= x1; ++x)
+            visited.set(x, y);
+        if (onSpan)
+            onSpan(y, x0, x1);
+    };
+    return growSpans(width, height, seed, open, take);
+}
+
+QRect fill(QImage& image, const QPoint& seed, const QColor& color, int tolerance)
+{
+    return fill(image, image, seed, color, tolerance);
+}
+
+QRect fill(QImage& image, const QImage& reference, const QPoint& seed, const QColor& color, int tolerance,
+           const QRect& clip)
+{
+    const QRect area = clip.isNull() ? image.rect() : clip & image.rect();
+    if (!area.contains(seed))
+        return QRect();
+
+    if (image.format() != QImage::Format_ARGB32_Premultiplied)
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    // Область ищется по reference, а заливается в image; без reference это один слой
+    const bool sameImage = (&reference == &image);
+    if (!sameImage && (reference.size() != image.size() || reference.format() != QImage::Format_ARGB32_Premultiplied))
+        return fill(image, image, seed, color, tolerance, clip);
+
+    const QRgb target = reinterpret_cast<const QRgb*>(reference.constScanLine(seed.y()))[seed.x()];
+    const QRgb fillPixel = qPremultiply(color.rgba());
+    if (sameImage && target == fillPixel)
+        return QRect();
+
+    // Отделяем данные заранее, чтобы scanLine() в обработчике не копировал изображение
+    image.bits();
+
+    const ToleranceBounds bounds = toleranceBounds(target, tolerance);
+    // Область растет по всему слою, но пишется только внутри area
+    const QRect region = growRegion(reference, seed, bounds, [&](int y, int x0, int x1) {
+        x0 = qMax(x0, area.left());
+        x1 = qMin(x1, area.right());
+        if (y < area.top() || y > area.bottom() || x0 > x1)
+            return;
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        std::fill(line + x0, line + x1 + 1, fillPixel);
+    });
+    return region & area;
+}
+
+namespace
+{
+    // Граничные пиксели маски (у которых есть сосед с другим значением) получают
+    // среднее по окрестности 3x3; внутренние и внешние пиксели не трогаются
+    QImage smoothEdges(const QImage& mask)
+    {
+        QImage result = mask.copy();
+        const int width = mask.width();
+        const int height = mask.height();
+        const uchar* src = mask.constBits();
+        const qsizetype srcStride = mask.bytesPerLine();
+        uchar* dst = result.bits();
+        const qsizetype dstStride = result.bytesPerLine();
+
+        Parallel::forRanges(height, 64, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                const uchar* row = src + y * srcStride;
+                const uchar* up = y > 0 ? row - srcStride : nullptr;
+                const uchar* down = y + 1 < height ? row + srcStride : nullptr;
+                uchar* out = dst + y * dstStride;
+
+                for (int x = 0; x < width; ++x) {
+                    const uchar v = row[x];
+                    const bool edge = (x > 0 && row[x - 1] != v) || (x + 1 < width && row[x + 1] != v)
+                        || (up && up[x] != v) || (down && down[x] != v);
+                    if (!edge)
+                        continue;
+
+                    // За краем холста соседей нет, а не "пусто"
+                    int sum = 0, count = 0;
+                    for (const uchar* line : { up, row, down }) {
+                        if (!line)
+                            continue;
+                        for (int dx = qMax(0, x - 1); dx <= qMin(width - 1, x + 1); ++dx) {
+                            sum += line[dx];
+                            ++count;
+                        }
+                    }
+                    out[x] = uchar((sum + count / 2) / count);
+                }
+            }
+        });
+        return result;
+    }
+}
+
+QImage regionMask(const QImage& image, const QPoint& seed, int tolerance, bool antialias, QPoint& offset)
+{
+    offset = QPoint();
+    if (!image.rect().contains(seed))
+        return QImage();
+
+    const QImage source = image.format() == QImage::Format_ARGB32_Premultiplied
+        ? image : image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QRgb target = reinterpret_cast<const QRgb*>(source.constScanLine(seed.y()))[seed.x()];
+
+    // Отрезки запоминаются, а маска заводится, когда границы области уже известны
+    struct Span { int y, x0, x1; };
+    QVector<Span> spans;
+    const QRect region = growRegion(source, seed, toleranceBounds(target, tolerance), [&](int y, int x0, int x1) {
+        spans.append({ y, x0, x1 });
+    });
+    if (region.isEmpty())
+        return QImage();
+
+    // Сглаженный край выходит на пиксель за область
+    const QRect bounds = antialias ? region.adjusted(-1, -1, 1, 1) & source.rect() : region;
+    QImage mask(bounds.size(), QImage::Format_Alpha8);
+    mask.fill(0);
+    uchar* bits = mask.bits();
+    const qsizetype bytesPerLine = mask.bytesPerLine();
+    for (const Span& span : spans)
+        std::memset(bits + (span.y - bounds.top()) * bytesPerLine + (span.x0 - bounds.left()), 255, span.x1 - span.x0 + 1);
+
+    offset = bounds.topLeft();
+    return antialias ? smoothEdges(mask) : mask;
+}
+
+namespace
+{
+    // Есть ли в строке пиксель, который заливка изменит. Допуск проверяется по ref,
+    // пишется в line (при заливке по одному слою это одна и та же строка)
+    bool rowNeedsReplace(const QRgb* line, const QRgb* ref, int count, const ToleranceBounds& bounds, QRgb fillPixel)
+    {
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i lo = _mm_set1_epi32(int(bounds.low()));
+        const __m128i hi = _mm_set1_epi32(int(bounds.high()));
+        const __m128i fill = _mm_set1_epi32(int(fillPixel));
+        const __m128i ones = _mm_set1_epi32(-1);
+        for (; x + 4 <= count; x += 4) {
+            const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + x));
+            const __m128i inRange = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(r, lo), r),
+                                                  _mm_cmpeq_epi8(_mm_min_epu8(r, hi), r));
+            const __m128i match = _mm_cmpeq_epi32(inRange, ones);
+            if (_mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi32(p, fill), match)))
+                return true;
+        }
+#endif
+        for (; x < count; ++x) {
+            if (line[x] != fillPixel && bounds.contains(ref[x]))
+                return true;
+        }
+        return false;
+    }
+
+    void replaceRow(QRgb* line, const QRgb* ref, int count, const ToleranceBounds& bounds, QRgb fillPixel)
+    {
+        int x = 0;
+#ifdef __SSE2__
+        // Байт в допуске, если max(p, lo) == p и min(p, hi) == p; пиксель - если все четыре байта
+        const __m128i lo = _mm_set1_epi32(int(bounds.low()));
+        const __m128i hi = _mm_set1_epi32(int(bounds.high()));
+        const __m128i fill = _mm_set1_epi32(int(fillPixel));
+        const __m128i ones = _mm_set1_epi32(-1);
+        for (; x + 4 <= count; x += 4) {
+            __m128i* ptr = reinterpret_cast<__m128i*>(line + x);
+            const __m128i p = _mm_loadu_si128(ptr);
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + x));
+            const __m128i inRange = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(r, lo), r),
+                                                  _mm_cmpeq_epi8(_mm_min_epu8(r, hi), r));
+            const __m128i match = _mm_cmpeq_epi32(inRange, ones);
+            _mm_storeu_si128(ptr, _mm_or_si128(_mm_and_si128(match, fill), _mm_andnot_si128(match, p)));
+        }
+#endif
+        for (; x < count; ++x) {
+            if (bounds.contains(ref[x]))
+                line[x] = fillPixel;
+        }
+    }
+}
+
+QVector<QRect> replaceColor(QImage& image, const QPoint& seed, const QColor& color, int tolerance)
+{
+    return replaceColor(image, image, seed, color, tolerance);
+}
+
+QVector<QRect> replaceColor(QImage& image, const QImage& reference, const QPoint& seed,
+                            const QColor& color, int tolerance, const QRect& clip)
+{
+    if (seed.x() < 0 || seed.y() < 0 || seed.x() >= image.width() || seed.y() >= image.height())
+        return {};
+
+    if (image.format() != QImage::Format_ARGB32_Premultiplied)
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const bool sameImage = (&reference == &image);
+    if (!sameImage && (reference.size() != image.size() || reference.format() != QImage::Format_ARGB32_Premultiplied))
+        return replaceColor(image, image, seed, color, tolerance, clip);
+
+    const QRect area = clip.isNull() ? image.rect() : clip & image.rect();
+    if (area.isEmpty())
+        return {};
+
+    // Отделение данных должно случиться здесь, а не одновременно в нескольких потоках
+    uchar* bits = image.bits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    const uchar* refBits = sameImage ? bits : reference.constBits();
+    const qsizetype refBytesPerLine = reference.bytesPerLine();
+
+    const QRgb target = reinterpret_cast<const QRgb*>(refBits + seed.y() * refBytesPerLine)[seed.x()];
+    const QRgb fillPixel = qPremultiply(color.rgba());
+    const ToleranceBounds bounds = toleranceBounds(target, tolerance);
+
+    const int tile = IMAGE_TILE_SIZE;
+    const int tileRows = (area.height() + tile - 1) / tile;
+    QVector<QVector<QRect>> changedByRow(tileRows);
+
+    // Каждая полоса плиток пишет только в свои строки и в свой список
+    Parallel::forRanges(tileRows, 1, [&](int firstRow, int endRow) {
+        for (int tileRow = firstRow; tileRow < endRow; ++tileRow) {
+            const int y0 = area.top() + tileRow * tile;
+            const int y1 = qMin(area.bottom() + 1, y0 + tile);
+            for (int x0 = area.left(); x0 <= area.right(); x0 += tile) {
+                const int width = qMin(tile, area.right() + 1 - x0);
+
+                bool changed = false;
+                for (int y = y0; y < y1; ++y) {
+                    QRgb* line = reinterpret_cast<QRgb*>(bits + y * bytesPerLine) + x0;
+                    const QRgb* ref = reinterpret_cast<const QRgb*>(refBits + y * refBytesPerLine) + x0;
+                    if (!changed) {
+                        if (!rowNeedsReplace(line, ref, width, bounds, fillPixel))
+                            continue;
+                        changed = true;
+                    }
+                    replaceRow(line, ref, width, bounds, fillPixel);
+                }
+                if (changed)
+                    changedByRow[tileRow].append(QRect(x0, y0, width, y1 - y0));
+            }
+        }
+    });
+
+    QVector<QRect> changed;
+    for (const QVector<QRect>& row : changedByRow)
+        changed += row;
+    return changed;
+}
+
+}
@@ -0,0 +1,114 @@
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+
+#include <QImage>
+#include <QRect>
+#include <QPoint>
+#include <QVector>
+#include <functional>
+
+// Заливка и выделение связных областей. Изображения - Format_ARGB32_Premultiplied,
+// пиксели сравниваются в упакованном виде без перевода в QColor.
+namespace FloodFill
+{
+    // Допуск вокруг цвета: каждый канал (A, R, G, B) лежит в [lo, lo + range]
+    struct ToleranceBounds
+    {
+        uchar lo[4];
+        uchar range[4];
+
+        bool contains(QRgb p) const
+        {
+            return uint(uchar(p >> 24) - lo[0]) <= range[0]
+                && uint(uchar(p >> 16) - lo[1]) <= range[1]
+                && uint(uchar(p >> 8)  - lo[2]) <= range[2]
+                && uint(uchar(p)       - lo[3]) <= range[3];
+        }
+
+        // Нижняя и верхняя границы, упакованные как пиксель
+        QRgb low() const { return qRgba(lo[1], lo[2], lo[3], lo[0]); }
+        QRgb high() const { return qRgba(lo[1] + range[1], lo[2] + range[2], lo[3] + range[3], lo[0] + range[0]); }
+    };
+
+    ToleranceBounds toleranceBounds(QRgb target, int tolerance);
+
+    // Ядро обхода по отрезкам строк. open(x, y) - пиксель еще не пройден и подходит;
+    // take(y, x0, x1) забирает отрезок в область, после чего open для него ложно.
+    // В стеке лежат только начала отрезков соседних строк, а не отдельные пиксели.
+    template <typename Open, typename Take>
+    QRect growSpans(int width, int height, const QPoint& seed, Open open, Take take)
+    {
+        if (seed.x() < 0 || seed.y() < 0 || seed.x() >= width || seed.y() >= height)
+            return QRect();
+
+        QVector<QPoint> stack;
+        stack.append(seed);
+
+        int left = width, right = -1, top = height, bottom = -1;
+
+        while (!stack.isEmpty()) {
+            const QPoint p = stack.takeLast();
+            const int y = p.y();
+            if (!open(p.x(), y))
+                continue;
+
+            int x0 = p.x();
+            while (x0 > 0 && open(x0 - 1, y))
+                --x0;
+            int x1 = p.x();
+            while (x1 < width - 1 && open(x1 + 1, y))
+                ++x1;
+
+            take(y, x0, x1);
+
+            left = qMin(left, x0);
+            right = qMax(right, x1);
+            top = qMin(top, y);
+            bottom = qMax(bottom, y);
+
+            // Соседние строки: по одному семени на каждый подходящий отрезок
+            for (int ny : { y - 1, y + 1 }) {
+                if (ny < 0 || ny >= height)
+                    continue;
+                bool inRun = false;
+                for (int x = x0; x <= x1; ++x) {
+                    const bool next = open(x, ny);
+                    if (next && !inRun)
+                        stack.append(QPoint(x, ny));
+                    inRun = next;
+                }
+            }
+        }
+
+        if (right < 0)
+            return QRect();
+        return QRect(QPoint(left, top), QPoint(right, bottom));
+    }
+
+    // Вызывается для каждого найденного отрезка строки y: пиксели x0..x1 включительно
+    using SpanFunction = std::function<void(int y, int x0, int x1)>;
+
+    // Обходит 4-связную область вокруг seed. Каждый пиксель отдается ровно один раз,
+    // поэтому onSpan может менять image на месте. Возвращает границы области.
+    QRect growRegion(const QImage& image, const QPoint& seed,
+                     const ToleranceBounds& bounds, const SpanFunction& onSpan);
+
+    // Заливает область вокруг seed цветом color, возвращает измененный прямоугольник
+    QRect fill(QImage& image, const QPoint& seed, const QColor& color, int tolerance);
+    // То же, но область определяется по reference (например, композиту всех слоев).
+    // Пишется только внутри clip (пустой clip - весь слой)
+    QRect fill(QImage& image, const QImage& reference, const QPoint& seed, const QColor& color, int tolerance,
+               const QRect& clip = QRect());
+
+    // Маска связной области вокруг seed (Format_Alpha8) только в ее границах,
+    // offset - положение маски на холсте. antialias смягчает край усреднением 3x3.
+    QImage regionMask(const QImage& image, const QPoint& seed, int tolerance, bool antialias, QPoint& offset);
+
+    // Заменяет все пиксели слоя в допуске от цвета под seed, связность не важна.
+    // Работает полосами плиток в пуле потоков; возвращает только измененные плитки.
+    QVector<QRect> replaceColor(QImage& image, const QPoint& seed, const QColor& color, int tolerance);
+    QVector<QRect> replaceColor(QImage& image, const QImage& reference, const QPoint& seed,
+                                const QColor& color, int tolerance, const QRect& clip = QRect());
+}
+
+#endif // FLOODFILL_H
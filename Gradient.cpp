@@ -0,0 +1,130 @@
+#include "Gradient.h"
+#include "Parallel.h"
+#include "Config.h"
+#include <QColor>
+#include <QtMath>
+#include <cmath>
+
+namespace
+{
+
+// Порог для пикселя (x, y) из матрицы Байера 4x4, в 1/256 уровня
+const int BayerThreshold[4][4] = {
+    {   8, 136,  40, 168 },
+    { 200,  72, 232, 104 },
+    {  56, 184,  24, 152 },
+    { 248, 120, 216,  88 }
+};
+
+// Таблица цветов: premultiplied каналы с 8 дробными битами, чтобы дизеринг
+// различал промежуточные значения между соседними уровнями
+QVector<quint16> buildRamp(const QGradientStops& stops)
+{
+    QVector<quint16> ramp(GRADIENT_RAMP_SIZE * 4);
+    for (int i = 0; i < GRADIENT_RAMP_SIZE; ++i) {
+        const qreal t = qreal(i) / (GRADIENT_RAMP_SIZE - 1);
+
+        QColor color = stops.isEmpty() ? QColor(Qt::transparent) : stops.first().second;
+        for (int s = 1; s < stops.size(); ++s) {
+            if (t > stops[s].first)
+                continue;
+            const qreal from = stops[s - 1].first;
+            const qreal span = stops[s].first - from;
+            const qreal k = span > 0.0 ? qBound(0.0, (t - from) / span, 1.0) : 1.0;
+            const QColor& a = stops[s - 1].second;
+            const QColor& b = stops[s].second;
+            color = QColor::fromRgbF(a.redF() + (b.redF() - a.redF()) * k,
+                                     a.greenF() + (b.greenF() - a.greenF()) * k,
+                                     a.blueF() + (b.blueF() - a.blueF()) * k,
+                                     a.alphaF() + (b.alphaF() - a.alphaF()) * k);
+            break;
+        }
+        if (!stops.isEmpty() && t > stops.last().first)
+            color = stops.last().second;
+
+        const qreal alpha = color.alphaF();
+        quint16* entry = ramp.data() + i * 4;
+        // Порядок каналов как в памяти QRgb: B, G, R, A
+        entry[0] = quint16(qRound(color.blueF() * alpha * 255.0 * 256.0));
+        entry[1] = quint16(qRound(color.greenF() * alpha * 255.0 * 256.0));
+        entry[2] = quint16(qRound(color.redF() * alpha * 255.0 * 256.0));
+        entry[3] = quint16(qRound(alpha * 255.0 * 256.0));
+    }
+    return ramp;
+}
+
+}
+
+namespace Gradient
+{
+
+void render(QImage& target, const QRectF& area, const Settings& settings)
+{
+    if (target.isNull() || area.isEmpty())
+        return;
+
+    const QVector<quint16> ramp = buildRamp(settings.stops);
+    const int width = target.width();
+    const qreal stepX = area.width() / width;
+    const qreal stepY = area.height() / target.height();
+
+    const QPointF axis = settings.end - settings.start;
+    const qreal length = qMax<qreal>(1e-6, std::hypot(axis.x(), axis.y()));
+    const qreal axisAngle = std::atan2(axis.y(), axis.x());
+
+    uchar* bits = target.bits();
+    const qsizetype stride = target.bytesPerLine();
+
+    Parallel::forRanges(target.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+        QVector<float> param(width);
+        for (int y = begin; y < end; ++y) {
+            // Сначала параметр вдоль строки: для линейного и радиального - простые
+            // арифметические циклы без ветвлений
+            const qreal dy = area.top() + (y + 0.5) * stepY - settings.start.y();
+            const qreal x0 = area.left() + 0.5 * stepX - settings.start.x();
+            float* t = param.data();
+
+            switch (settings.shape) {
+            case GradientShape::Linear: {
+                const float base = float((x0 * axis.x() + dy * axis.y()) / (length * length));
+                const float step = float(stepX * axis.x() / (length * length));
+                for (int x = 0; x < width; ++x)
+                    t[x] = base + step * x;
+                break;
+            }
+            case GradientShape::Radial: {
+                const float dy2 = float(dy * dy);
+                const float inverse = float(1.0 / length);
+                for (int x = 0; x < width; ++x) {
+                    const float dx = float(x0 + stepX * x);
+                    t[x] = std::sqrt(dx * dx + dy2) * inverse;
+                }
+                break;
+            }
+            case GradientShape::Angular: {
+                const float turn = float(2.0 * M_PI);
+                for (int x = 0; x < width; ++x) {
+                    float angle = std::atan2(float(dy), float(x0 + stepX * x)) - float(axisAngle);
+                    if (angle < 0.0f)
+                        angle += turn;
+                    t[x] = angle / turn;
+                }
+                break;
+            }
+            }
+
+            // Затем цвет из таблицы; дизеринг добавляет порог до отбрасывания дробной части
+            uchar* line = bits + y * stride;
+            const int* threshold = BayerThreshold[y & 3];
+            for (int x = 0; x < width; ++x) {
+                const float clamped = qBound(0.0f, t[x], 1.0f);
+                const quint16* entry = ramp.constData() + int(clamped * (GRADIENT_RAMP_SIZE - 1) + 0.5f) * 4;
+                const int bias = settings.dither ? threshold[x & 3] : 128;
+                for (int c = 0; c < 4; ++c)
+                    line[x * 4 + c] = uchar(qMin(255, (entry[c] + bias) >> 8));
+            }
+        }
+    });
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef GRADIENT_H
+#define GRADIENT_H
+
+#include <QImage>
+#include <QGradientStops>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include "ToolType.h"
+
+// Градиент, рассчитанный по строкам без QPainter: для строки сначала
+// считается параметр t каждого пикселя, затем цвет берется из таблицы
+namespace Gradient
+{
+    struct Settings
+    {
+        GradientShape shape = GradientShape::Linear;
+        QPointF start;          // в координатах документа
+        QPointF end;
+        QGradientStops stops;   // цвета в точках 0..1
+        bool dither = false;    // упорядоченный дизеринг 4x4 вместо округления
+    };
+
+    // Заполняет target (Format_ARGB32_Premultiplied) градиентом. target покрывает
+    // прямоугольник документа area; строки делятся между потоками
+    void render(QImage& target, const QRectF& area, const Settings& settings);
+}
+
+#endif // GRADIENT_H
@@ -0,0 +1,144 @@
+#include "ImageOrientation.h"
+#include "Parallel.h"
+#include "Config.h"
+#include <algorithm>
+
+namespace
+{
+
+void flipHorizontal(QImage& image)
+{
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+    const int width = image.width();
+
+    Parallel::forRanges(image.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(bits + y * stride);
+            std::reverse(line, line + width);
+        }
+    });
+}
+
+void flipVertical(QImage& image)
+{
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+    const int height = image.height();
+    const qsizetype bytes = qsizetype(image.width()) * 4;
+
+    // Меняются местами пары строк; средняя строка нечетной высоты остается
+    Parallel::forRanges(height / 2, IMAGE_TILE_SIZE, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            uchar* top = bits + y * stride;
+            uchar* bottom = bits + (height - 1 - y) * stride;
+            std::swap_ranges(top, top + bytes, bottom);
+        }
+    });
+}
+
+void rotate180(QImage& image)
+{
+    uchar* bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+    const int width = image.width();
+    const int height = image.height();
+
+    // Пиксель (x, y) меняется с (w - 1 - x, h - 1 - y): пары строк, прочитанные навстречу
+    Parallel::forRanges(height / 2, IMAGE_TILE_SIZE, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            QRgb* top = reinterpret_cast<QRgb*>(bits + y * stride);
+            QRgb* bottom = reinterpret_cast<QRgb*>(bits + (height - 1 - y) * stride);
+            for (int x = 0; x < width; ++x)
+                std::swap(top[x], bottom[width - 1 - x]);
+        }
+    });
+
+    if (height % 2) {
+        QRgb* middle = reinterpret_cast<QRgb*>(bits + (height / 2) * stride);
+        std::reverse(middle, middle + width);
+    }
+}
+
+// Поворот на 90 с транспонированием по плиткам: и чтение, и запись плитки
+// укладываются в кэш, вместо прохода по столбцу через все изображение
+QImage rotateQuarter(const QImage& image, bool clockwise)
+{
+    const int width = image.width();
+    const int height = image.height();
+    QImage result(height, width, image.format());
+
+    const uchar* srcBits = image.constBits();
+    const qsizetype srcStride = image.bytesPerLine();
+    uchar* dstBits = result.bits();
+    const qsizetype dstStride = result.bytesPerLine();
+
+    const int columns = (width + IMAGE_TILE_SIZE - 1) / IMAGE_TILE_SIZE;
+    const int bands = (height + IMAGE_TILE_SIZE - 1) / IMAGE_TILE_SIZE;
+    Parallel::forRanges(columns * bands, 1, [&](int begin, int end) {
+        for (int block = begin; block < end; ++block) {
+            const int x0 = (block % columns) * IMAGE_TILE_SIZE;
+            const int y0 = (block / columns) * IMAGE_TILE_SIZE;
+            const int x1 = qMin(width, x0 + IMAGE_TILE_SIZE);
+            const int y1 = qMin(height, y0 + IMAGE_TILE_SIZE);
+
+            for (int x = x0; x < x1; ++x) {
+                // Строка результата: по часовой (x, y) -> (h - 1 - y, x), против - (y, w - 1 - x)
+                QRgb* dst = reinterpret_cast<QRgb*>(dstBits + (clockwise ? x : width - 1 - x) * dstStride);
+                for (int y = y0; y < y1; ++y) {
+                    const QRgb pixel = reinterpret_cast<const QRgb*>(srcBits + y * srcStride)[x];
+                    dst[clockwise ? height - 1 - y : y] = pixel;
+                }
+            }
+        }
+    });
+    return result;
+}
+
+}
+
+namespace ImageOrientation
+{
+
+Orientation inverse(Orientation orientation)
+{
+    switch (orientation) {
+    case Orientation::Rotate90:
+        return Orientation::Rotate270;
+    case Orientation::Rotate270:
+        return Orientation::Rotate90;
+    default:
+        return orientation;
+    }
+}
+
+bool swapsSize(Orientation orientation)
+{
+    return orientation == Orientation::Rotate90 || orientation == Orientation::Rotate270;
+}
+
+void apply(QImage& image, Orientation orientation)
+{
+    if (image.isNull() || image.depth() != 32)
+        return;
+
+    switch (orientation) {
+    case Orientation::Rotate90:
+        image = rotateQuarter(image, true);
+        break;
+    case Orientation::Rotate270:
+        image = rotateQuarter(image, false);
+        break;
+    case Orientation::Rotate180:
+        rotate180(image);
+        break;
+    case Orientation::FlipHorizontal:
+        flipHorizontal(image);
+        break;
+    case Orientation::FlipVertical:
+        flipVertical(image);
+        break;
+    }
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef IMAGEORIENTATION_H
+#define IMAGEORIENTATION_H
+
+#include <QImage>
+
+// Повороты на прямой угол и отражения без пересчета пикселей
+enum class Orientation {
+    Rotate90,       // по часовой
+    Rotate180,
+    Rotate270,      // против часовой
+    FlipHorizontal,
+    FlipVertical
+};
+
+namespace ImageOrientation
+{
+    // Операция, отменяющая orientation
+    Orientation inverse(Orientation orientation);
+
+    // Меняет ли операция местами ширину и высоту
+    bool swapsSize(Orientation orientation);
+
+    // Применяет операцию к 32-битному изображению. Отражения и поворот на 180
+    // выполняются на месте; для 90 и 270 image заменяется новым изображением,
+    // которое заполняется транспонированием по блокам плиток
+    void apply(QImage& image, Orientation orientation);
+}
+
+#endif // IMAGEORIENTATION_H
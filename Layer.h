@@ -5,12 +5,24 @@
 #include <QString>
 #include <QRect>
 
+// Постоянный идентификатор слоя, не меняется при перемещениях. 0 - нет слоя
+using LayerId = int;
+
+enum class LayerProperty {
+    Visibility,
+    Opacity,
+    Name
+};
+
 class Layer
 {
 public:
     Layer(const QSize& size, const QString& name = "Layer");
     ~Layer() = default;
 
+    LayerId id() const { return m_id; }
+    void setId(LayerId id) { m_id = id; }
+
     void setVisible(bool visible) { m_visible = visible; }
     bool isVisible() const { return m_visible; }
 
@@ -23,11 +35,13 @@ public:
     QImage& image() { return m_image; }
     const QImage& image() const { return m_image; }
 
-    void setImage(const QImage& image) { m_image = image; }
+    // Слой всегда хранит Format_ARGB32_Premultiplied: на это опираются инструменты
+    void setImage(const QImage& image) { m_image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied); }
 
     void paint(QPainter& painter, const QRect& destRect);
 
 private:
+    LayerId m_id = 0;
     QImage m_image;
     QString m_name;
     bool m_visible = true;
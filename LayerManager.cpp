@@ -13,12 +13,16 @@ void LayerManager::addLayer(std::unique_ptr<Layer> layer)
 {
     if (!layer) return;
 
+    assignId(layer.get());
     m_layers.push_back(std::move(layer));
+    reindex(static_cast<int>(m_layers.size()) - 1);
+    invalidateComposite();
+    if (!deferStructureChange())
+        emit layerInserted(static_cast<int>(m_layers.size()) - 1);
+
     if (!m_activeLayer) {
         setActiveLayer(static_cast<int>(m_layers.size()) - 1);
     }
-
-    emit layersChanged();
 }
 
 void LayerManager::removeLayer(int index)
@@ -28,17 +32,23 @@ void LayerManager::removeLayer(int index)
 
     bool wasActive = (m_activeLayer == m_layers[index].get());
 
+    m_slotById.remove(m_layers[index]->id());
     m_layers.erase(m_layers.begin() + index);
+    if (wasActive) {
+        m_activeLayer = nullptr;
+    }
+    reindex(index);
+    invalidateComposite();
+    if (!deferStructureChange())
+        emit layerRemoved(index);
 
-    if (wasActive || !m_activeLayer) {
+    if (!m_activeLayer) {
         if (m_layers.empty()) {
             m_activeLayer = nullptr;
         } else {
             setActiveLayer(qMin(index, static_cast<int>(m_layers.size()) - 1));
         }
     }
-
-    emit layersChanged();
 }
 
 void LayerManager::moveLayer(int fromIndex, int toIndex)
@@ -51,8 +61,11 @@ void LayerManager::moveLayer(int fromIndex, int toIndex)
     auto layer = std::move(m_layers[fromIndex]);
     m_layers.erase(m_layers.begin() + fromIndex);
     m_layers.insert(m_layers.begin() + toIndex, std::move(layer));
+    reindex(qMin(fromIndex, toIndex));
+    invalidateComposite();
 
-    emit layersChanged();
+    if (!deferStructureChange())
+        emit layerMoved(fromIndex, toIndex);
 }
 
 void LayerManager::duplicateLayer(int index)
@@ -106,6 +119,7 @@ void LayerManager::setActiveLayer(int index)
 {
     if (index < 0 || index >= static_cast<int>(m_layers.size())) {
         m_activeLayer = nullptr;
+        m_activeIndex = -1;
         return;
     }
 
@@ -113,20 +127,169 @@ void LayerManager::setActiveLayer(int index)
     Layer* newActive = m_layers[index].get();
     if (m_activeLayer != newActive) {
         m_activeLayer = newActive;
-        emit activeLayerChanged(index);
+        m_activeIndex = index;
+        if (m_batchDepth == 0)
+            emit activeLayerChanged(index);
+        else
+            m_batchActiveChanged = true;
+    }
+}
+
+void LayerManager::assignId(Layer* layer)
+{
+    // Слой, возвращаемый отменой, сохраняет свой id, чтобы команды продолжали его находить
+    if (layer->id() <= 0 || m_slotById.contains(layer->id())) {
+        layer->setId(m_nextId++);
+    } else {
+        m_nextId = qMax(m_nextId, layer->id() + 1);
+    }
+}
+
+void LayerManager::reindex(int from)
+{
+    for (int i = qMax(0, from); i < static_cast<int>(m_layers.size()); ++i) {
+        m_slotById[m_layers[i]->id()] = i;
+    }
+
+    m_activeIndex = m_activeLayer ? indexOf(m_activeLayer->id()) : -1;
+}
+
+void LayerManager::setLayerVisible(int index, bool visible)
+{
+    Layer* layer = layerAt(index);
+    if (!layer || layer->isVisible() == visible)
+        return;
+
+    layer->setVisible(visible);
+    notifyPropertyChanged(index, LayerProperty::Visibility);
+}
+
+void LayerManager::setLayerOpacity(int index, float opacity)
+{
+    Layer* layer = layerAt(index);
+    if (!layer || qFuzzyCompare(layer->opacity(), opacity))
+        return;
+
+    layer->setOpacity(opacity);
+    notifyPropertyChanged(index, LayerProperty::Opacity);
+}
+
+void LayerManager::setLayerName(int index, const QString& name)
+{
+    Layer* layer = layerAt(index);
+    if (!layer || layer->name() == name)
+        return;
+
+    layer->setName(name);
+    notifyPropertyChanged(index, LayerProperty::Name);
+}
+
+void LayerManager::setLayerImage(int index, const QImage& image)
+{
+    Layer* layer = layerAt(index);
+    if (!layer)
+        return;
+
+    layer->setImage(image);
+    notifyPixelsChanged(index);
+}
+
+void LayerManager::replaceLayerImages(const QHash<LayerId, QImage>& images)
+{
+    BatchScope batch(this);
+
+    for (auto it = images.cbegin(); it != images.cend(); ++it) {
+        if (Layer* layer = layerById(it.key()))
+            layer->setImage(it.value());
     }
+    clearSelection();
+    invalidateComposite();
+
+    if (!deferStructureChange())
+        emit layersReset();
 }
 
-int LayerManager::activeLayerIndex() const
+void LayerManager::notifyPixelsChanged(int index, const QRect& rect)
 {
-    if (!m_activeLayer) return -1;
+    const Layer* layer = layerAt(index);
+    if (!layer)
+        return;
+
+    const QRect bounds = layer->image().rect();
+    const QRect dirty = rect.isNull() ? bounds : rect.intersected(bounds);
+    if (dirty.isEmpty())
+        return;
+
+    // Кэш помечается сразу, даже внутри пакета: его могут прочитать до конца пакета
+    invalidateComposite(dirty);
+
+    if (m_batchDepth > 0) {
+        m_batchPixels[index] = m_batchPixels.value(index).united(dirty);
+        return;
+    }
 
-    for (int i = 0; i < static_cast<int>(m_layers.size()); ++i) {
-        if (m_layers[i].get() == m_activeLayer) {
-            return i;
+    emit layerPixelsChanged(index, dirty);
+}
+
+void LayerManager::notifyPropertyChanged(int index, LayerProperty property)
+{
+    if (property != LayerProperty::Name)
+        invalidateComposite();
+
+    if (m_batchDepth > 0) {
+        m_batchProperties[index] |= 1 << static_cast<int>(property);
+        return;
+    }
+
+    emit layerPropertyChanged(index, property);
+}
+
+bool LayerManager::deferStructureChange()
+{
+    if (m_batchDepth == 0)
+        return false;
+
+    m_batchStructural = true;
+    return true;
+}
+
+void LayerManager::beginBatch()
+{
+    ++m_batchDepth;
+}
+
+void LayerManager::endBatch()
+{
+    if (m_batchDepth == 0 || --m_batchDepth > 0)
+        return;
+
+    const bool structural = m_batchStructural;
+    const bool activeChanged = m_batchActiveChanged;
+    const QHash<int, QRect> pixels = std::move(m_batchPixels);
+    const QHash<int, int> properties = std::move(m_batchProperties);
+
+    m_batchStructural = false;
+    m_batchActiveChanged = false;
+    m_batchPixels.clear();
+    m_batchProperties.clear();
+
+    if (structural) {
+        // Индексы могли сместиться, поэтому все изменения сводятся к одному сбросу
+        emit layersReset();
+    } else {
+        for (auto it = pixels.cbegin(); it != pixels.cend(); ++it)
+            emit layerPixelsChanged(it.key(), it.value());
+
+        for (auto it = properties.cbegin(); it != properties.cend(); ++it) {
+            for (LayerProperty property : { LayerProperty::Visibility, LayerProperty::Opacity, LayerProperty::Name }) {
+                if (it.value() & (1 << static_cast<int>(property)))
+                    emit layerPropertyChanged(it.key(), property);
+            }
         }
     }
-    return -1;
+
+    if (structural || activeChanged)
+        emit activeLayerChanged(activeLayerIndex());
 }
 
 QImage LayerManager::compositeImage(const QSize& size) const
@@ -140,6 +303,69 @@ QImage LayerManager::compositeImage(const QSize& size) const
     return result;
 }
 
+void LayerManager::setSelection(const Selection& selection)
+{
+    if (m_selection.isEmpty() && selection.isEmpty())
+        return;
+
+    const QRect changed = m_selection.bounds() | selection.bounds();
+    m_selection = selection;
+    emit selectionChanged(changed);
+}
+
+void LayerManager::invalidateComposite(const QRect& rect)
+{
+    if (m_compositeFullyDirty)
+        return;
+
+    // Пока кэш никто не читает, мелкие области сливаются в полную пересборку
+    if (rect.isNull() || m_compositeDirty.rectCount() > 64)
+        m_compositeFullyDirty = true;
+    else
+        m_compositeDirty += rect;
+}
+
+const QImage& LayerManager::mergedImage() const
+{
+    const QSize size = m_layers.empty() ? QSize() : m_layers.front()->image().size();
+    if (size.isEmpty()) {
+        m_composite = QImage();
+        m_compositeDirty = QRegion();
+        m_compositeFullyDirty = true;
+        return m_composite;
+    }
+
+    if (m_composite.size() != size) {
+        m_composite = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        m_compositeFullyDirty = true;
+    }
+
+    if (m_compositeFullyDirty) {
+        m_compositeDirty = QRegion(m_composite.rect());
+        m_compositeFullyDirty = false;
+    }
+    if (m_compositeDirty.isEmpty())
+        return m_composite;
+
+    QPainter painter(&m_composite);
+    for (const QRect& rect : m_compositeDirty) {
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(rect, Qt::transparent);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+        for (const auto& layer : m_layers) {
+            if (!layer->isVisible() || layer->opacity() <= 0.0f)
+                continue;
+            painter.setOpacity(layer->opacity());
+            painter.drawImage(rect.topLeft(), layer->image(), rect);
+        }
+        painter.setOpacity(1.0);
+    }
+    m_compositeDirty = QRegion();
+
+    return m_composite;
+}
+
 void LayerManager::renderLayers(QPainter& painter, const QRect& destRect) const
 {
     for (const auto& layer : m_layers) {
@@ -180,18 +406,30 @@ void LayerManager::insertLayer(int index, std::unique_ptr<Layer> layer)
         return;
     }
 
+    assignId(layer.get());
     m_layers.insert(m_layers.begin() + index, std::move(layer));
+    reindex(index);
+    invalidateComposite();
+    if (!deferStructureChange())
+        emit layerInserted(index);
 
     if (!m_activeLayer) {
         setActiveLayer(0);
     }
-
-    emit layersChanged();
 }
 void LayerManager::ClearLayers()
 {
+    BatchScope batch(this);
+
     m_layers.clear();
+    m_slotById.clear();
+    clearSelection();
     m_activeLayer = nullptr;
+    m_activeIndex = -1;
+    invalidateComposite();
+
+    if (!deferStructureChange())
+        emit layersReset();
 }
 
 bool LayerManager::loadProject(const QString& filename)
@@ -210,6 +448,9 @@ bool LayerManager::loadProject(const QString& filename)
     if (header != "LAYER_PROJECT" || layerCount < 0)
         return false;
 
+    // Слои загружаются одним пакетом: панель и холст обновятся один раз
+    BatchScope batch(this);
+
     ClearLayers();
 
     for (int i = 0; i < layerCount; ++i) {
@@ -239,6 +480,5 @@ bool LayerManager::loadProject(const QString& filename)
         setActiveLayer(0);
     }
 
-    emit layersChanged();
     return true;
 }
@@ -3,9 +3,13 @@
 
 #include <QObject>
 #include <QSize>
+#include <QHash>
+#include <QImage>
+#include <QRegion>
 #include <vector>
 #include <memory>
 #include "Layer.h"
+#include "Selection.h"
 
 class LayerManager : public QObject
 {
@@ -28,12 +32,56 @@ public:
     const Layer* layerAt(int index) const;
     int layerCount() const { return m_layers.size(); }
 
+    // Поиск по постоянному идентификатору за O(1); -1 / nullptr, если слоя нет
+    int indexOf(LayerId id) const { return m_slotById.value(id, -1); }
+    Layer* layerById(LayerId id) { return layerAt(indexOf(id)); }
+    const Layer* layerById(LayerId id) const { return layerAt(indexOf(id)); }
+
     void setActiveLayer(int index);
     Layer* activeLayer() { return m_activeLayer; }
     const Layer* activeLayer() const { return m_activeLayer; }
-    int activeLayerIndex() const;
+    int activeLayerIndex() const { return m_activeIndex; }
+    LayerId activeLayerId() const { return m_activeLayer ? m_activeLayer->id() : 0; }
+
+    void setLayerVisible(int index, bool visible);
+    void setLayerOpacity(int index, float opacity);
+    void setLayerName(int index, const QString& name);
+    void setLayerImage(int index, const QImage& image);
+    // Меняет изображения сразу нескольких слоев, размер холста может стать другим.
+    // Выделение снимается, виды перестраиваются целиком
+    void replaceLayerImages(const QHash<LayerId, QImage>& images);
+
+    // Пустой rect означает, что изменился весь слой
+    void notifyPixelsChanged(int index, const QRect& rect = QRect());
+
+    // Пакетные изменения: сигналы копятся до закрытия внешнего пакета
+    // и отправляются одним сводным набором
+    void beginBatch();
+    void endBatch();
+    bool inBatch() const { return m_batchDepth > 0; }
+
+    class BatchScope
+    {
+    public:
+        explicit BatchScope(LayerManager* manager) : m_manager(manager) { if (m_manager) m_manager->beginBatch(); }
+        ~BatchScope() { if (m_manager) m_manager->endBatch(); }
+
+        BatchScope(const BatchScope&) = delete;
+        BatchScope& operator=(const BatchScope&) = delete;
+
+    private:
+        LayerManager* m_manager;
+    };
+
+    // Выделение общее для всех слоев; пустое - ограничений нет
+    const Selection& selection() const { return m_selection; }
+    void setSelection(const Selection& selection);
+    void clearSelection() { setSelection(Selection()); }
 
     QImage compositeImage(const QSize& size) const;
+    // Кэшированный композит видимых слоев в размере холста. Пересобираются только
+    // области, измененные с прошлого вызова; ссылка действительна до следующей правки
+    const QImage& mergedImage() const;
     void renderLayers(QPainter& painter, const QRect& destRect) const;
 
     bool saveProject(const QString& filename) const;
@@ -42,13 +90,51 @@ public:
     void ClearLayers();
 
 signals:
-    void layersChanged();
+    // Изменились пиксели слоя (rect в координатах изображения)
+    void layerPixelsChanged(int index, const QRect& rect);
+    // Изменилось свойство слоя (видимость, прозрачность, имя)
+    void layerPropertyChanged(int index, LayerProperty property);
+
+    // Структурные изменения
+    void layerInserted(int index);
+    void layerRemoved(int index);
+    void layerMoved(int fromIndex, int toIndex);
+    void layersReset();
+
     void activeLayerChanged(int index);
 
+    // rect - объединение старых и новых границ выделения
+    void selectionChanged(const QRect& rect);
+
 private:
+    void assignId(Layer* layer);
+    // Обновляет карту id -> индекс для слоев начиная с from и кэш активного индекса
+    void reindex(int from);
+
+    void notifyPropertyChanged(int index, LayerProperty property);
+    // Пустой rect - весь холст
+    void invalidateComposite(const QRect& rect = QRect());
+    // true, если изменение структуры отложено до конца пакета
+    bool deferStructureChange();
+
     std::vector<std::unique_ptr<Layer>> m_layers;
     Layer* m_activeLayer = nullptr;
+    int m_activeIndex = -1;
+    QHash<LayerId, int> m_slotById;
+    LayerId m_nextId = 1;
     QSize m_canvasSize;
+
+    Selection m_selection;
+
+    mutable QImage m_composite;
+    mutable QRegion m_compositeDirty;
+    mutable bool m_compositeFullyDirty = true;
+
+    int m_batchDepth = 0;
+    bool m_batchStructural = false;
+    bool m_batchActiveChanged = false;
+    QHash<int, QRect> m_batchPixels;
+    QHash<int, int> m_batchProperties;
 };
 
 #endif // LAYERMANAGER_H
@@ -0,0 +1,324 @@
+#include "LayerModel.h"
+#include <QPainter>
+#include <QMouseEvent>
+#include <QApplication>
+#include <QStyle>
+#include <QStyleOption>
+#include "Config.h"
+
+LayerModel::LayerModel(LayerManager* layerManager, QObject* parent)
+    : QAbstractListModel(parent)
+    , m_layerManager(layerManager)
+{
+    m_thumbnailTimer.setSingleShot(true);
+    m_thumbnailTimer.setInterval(LAYER_THUMBNAIL_UPDATE_MS);
+    connect(&m_thumbnailTimer, &QTimer::timeout, this, &LayerModel::flushThumbnails);
+
+    if (m_layerManager) {
+        m_thumbnails.resize(m_layerManager->layerCount());
+
+        connect(m_layerManager, &LayerManager::layerInserted,
+                this, &LayerModel::onLayerInserted);
+        connect(m_layerManager, &LayerManager::layerRemoved,
+                this, &LayerModel::onLayerRemoved);
+        connect(m_layerManager, &LayerManager::layerMoved,
+                this, &LayerModel::onLayerMoved);
+        connect(m_layerManager, &LayerManager::layersReset,
+                this, &LayerModel::onLayersReset);
+        connect(m_layerManager, &LayerManager::layerPropertyChanged,
+                this, &LayerModel::onLayerPropertyChanged);
+        connect(m_layerManager, &LayerManager::layerPixelsChanged,
+                this, &LayerModel::onLayerPixelsChanged);
+    }
+}
+
+// Число строк модели берется из кэша миниатюр: он меняется внутри begin/end,
+// поэтому во время уведомлений модель видит свое, а не уже обновленное состояние
+int LayerModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_thumbnails.size();
+}
+
+int LayerModel::rowFromLayerIndex(int layerIndex) const
+{
+    if (layerIndex < 0) return -1;
+    return m_thumbnails.size() - 1 - layerIndex;
+}
+
+int LayerModel::layerIndexFromRow(int row) const
+{
+    if (row < 0) return -1;
+    return m_thumbnails.size() - 1 - row;
+}
+
+QVariant LayerModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || !m_layerManager)
+        return QVariant();
+
+    const int layerIndex = layerIndexFromRow(index.row());
+    const Layer* layer = m_layerManager->layerAt(layerIndex);
+    if (!layer)
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return layer->name();
+    case Qt::CheckStateRole:
+        return layer->isVisible() ? Qt::Checked : Qt::Unchecked;
+    case OpacityRole:
+        return layer->opacity();
+    case ThumbnailRole:
+        return thumbnail(layerIndex);
+    case LayerIndexRole:
+        return layerIndex;
+    case LayerIdRole:
+        return layer->id();
+    default:
+        return QVariant();
+    }
+}
+
+bool LayerModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+    if (!index.isValid() || role != Qt::CheckStateRole)
+        return false;
+
+    emit visibilityToggleRequested(index.data(LayerIdRole).toInt(),
+                                   value.toInt() == Qt::Checked);
+    return true;
+}
+
+Qt::ItemFlags LayerModel::flags(const QModelIndex& index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled | Qt::ItemIsUserCheckable;
+}
+
+QImage LayerModel::thumbnail(int layerIndex) const
+{
+    if (layerIndex < 0 || layerIndex >= m_thumbnails.size())
+        return QImage();
+
+    QImage& cached = m_thumbnails[layerIndex];
+    if (cached.isNull()) {
+        // Миниатюра считается лениво, только для видимых строк
+        const Layer* layer = m_layerManager->layerAt(layerIndex);
+        if (layer && !layer->image().isNull()) {
+            cached = layer->image().scaled(LAYER_THUMBNAIL_WIDTH, LAYER_THUMBNAIL_HEIGHT,
+                                           Qt::KeepAspectRatio, Qt::FastTransformation);
+        }
+    }
+    return cached;
+}
+
+void LayerModel::onLayerInserted(int layerIndex)
+{
+    // Слой уже добавлен в LayerManager, поэтому begin/end вызываются подряд
+    const int row = m_thumbnails.size() - layerIndex;
+    beginInsertRows(QModelIndex(), row, row);
+    m_thumbnails.insert(layerIndex, QImage());
+    m_pendingThumbnails.clear();
+    endInsertRows();
+}
+
+void LayerModel::onLayerRemoved(int layerIndex)
+{
+    const int row = rowFromLayerIndex(layerIndex);
+    if (row < 0 || row >= m_thumbnails.size())
+        return;
+
+    beginRemoveRows(QModelIndex(), row, row);
+    m_thumbnails.removeAt(layerIndex);
+    m_pendingThumbnails.clear();
+    endRemoveRows();
+}
+
+void LayerModel::onLayerMoved(int fromIndex, int toIndex)
+{
+    const int fromRow = rowFromLayerIndex(fromIndex);
+    const int toRow = rowFromLayerIndex(toIndex);
+    const int destination = toRow > fromRow ? toRow + 1 : toRow;
+
+    if (beginMoveRows(QModelIndex(), fromRow, fromRow, QModelIndex(), destination)) {
+        m_thumbnails.move(fromIndex, toIndex);
+        m_pendingThumbnails.clear();
+        endMoveRows();
+    }
+}
+
+void LayerModel::onLayersReset()
+{
+    beginResetModel();
+    m_thumbnails.clear();
+    m_thumbnails.resize(m_layerManager ? m_layerManager->layerCount() : 0);
+    m_pendingThumbnails.clear();
+    endResetModel();
+}
+
+void LayerModel::onLayerPropertyChanged(int layerIndex, LayerProperty property)
+{
+    const QModelIndex idx = index(rowFromLayerIndex(layerIndex));
+    if (!idx.isValid())
+        return;
+
+    switch (property) {
+    case LayerProperty::Visibility:
+        emit dataChanged(idx, idx, { Qt::CheckStateRole });
+        break;
+    case LayerProperty::Opacity:
+        emit dataChanged(idx, idx, { OpacityRole });
+        break;
+    case LayerProperty::Name:
+        emit dataChanged(idx, idx, { Qt::DisplayRole, Qt::EditRole });
+        break;
+    }
+}
+
+void LayerModel::onLayerPixelsChanged(int layerIndex, const QRect& rect)
+{
+    Q_UNUSED(rect)
+    if (layerIndex < 0 || layerIndex >= m_thumbnails.size())
+        return;
+
+    // Старая миниатюра показывается до сброса по таймеру: иначе любая перерисовка
+    // строки во время штриха масштабировала бы слой целиком
+    m_pendingThumbnails.insert(layerIndex);
+    if (!m_thumbnailTimer.isActive())
+        m_thumbnailTimer.start();
+}
+
+void LayerModel::flushThumbnails()
+{
+    for (int layerIndex : std::as_const(m_pendingThumbnails)) {
+        if (layerIndex < 0 || layerIndex >= m_thumbnails.size())
+            continue;
+
+        // Пересчитается при следующей отрисовке строки, не чаще LAYER_THUMBNAIL_UPDATE_MS
+        m_thumbnails[layerIndex] = QImage();
+        const QModelIndex idx = index(rowFromLayerIndex(layerIndex));
+        emit dataChanged(idx, idx, { ThumbnailRole });
+    }
+    m_pendingThumbnails.clear();
+}
+
+// -------------------
+// LayerItemDelegate
+// -------------------
+LayerItemDelegate::LayerItemDelegate(QObject* parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+QRect LayerItemDelegate::checkBoxRect(const QRect& itemRect) const
+{
+    const int x = itemRect.left() + LAYER_ITEM_MARGIN + LAYER_ITEM_DRAG_ICON_SIZE + LAYER_ITEM_SPACING;
+    const int y = itemRect.top() + (itemRect.height() - LAYER_ITEM_VISIBILITY_SIZE) / 2;
+    return QRect(x, y, LAYER_ITEM_VISIBILITY_SIZE, LAYER_ITEM_VISIBILITY_SIZE);
+}
+
+void LayerItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+                              const QModelIndex& index) const
+{
+    painter->save();
+
+    const QRect r = option.rect;
+
+    if (option.state & QStyle::State_Selected)
+        painter->fillRect(r, QColor(LAYER_LIST_ITEM_SELECTED_BG));
+    else if (option.state & QStyle::State_MouseOver)
+        painter->fillRect(r, QColor(LAYER_LIST_ITEM_HOVER_BG));
+
+    painter->setPen(QColor(LAYER_LIST_ITEM_BORDER_BOTTOM));
+    painter->drawLine(r.bottomLeft(), r.bottomRight());
+
+    // Значок перетаскивания
+    QRect dragRect(r.left() + LAYER_ITEM_MARGIN, r.top(), LAYER_ITEM_DRAG_ICON_SIZE, r.height());
+    QFont iconFont = option.font;
+    iconFont.setPixelSize(LAYER_ITEM_DRAG_ICON_FONT_SIZE);
+    painter->setFont(iconFont);
+    painter->setPen(QColor(LAYER_ITEM_DRAG_ICON_COLOR));
+    painter->drawText(dragRect, Qt::AlignCenter, "☰");
+
+    // Флажок видимости
+    QStyleOptionButton checkOption;
+    checkOption.rect = checkBoxRect(r);
+    checkOption.state = QStyle::State_Enabled;
+    checkOption.state |= index.data(Qt::CheckStateRole).toInt() == Qt::Checked
+                             ? QStyle::State_On : QStyle::State_Off;
+    const QWidget* widget = option.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_CheckBox, &checkOption, painter, widget);
+
+    // Миниатюра на шахматном фоне
+    QRect thumbRect(checkOption.rect.right() + 1 + LAYER_ITEM_SPACING,
+                    r.top() + (r.height() - LAYER_THUMBNAIL_HEIGHT) / 2,
+                    LAYER_THUMBNAIL_WIDTH, LAYER_THUMBNAIL_HEIGHT);
+    const QImage thumb = index.data(LayerModel::ThumbnailRole).value<QImage>();
+    if (!thumb.isNull()) {
+        QRect imageRect(QPoint(0, 0), thumb.size());
+        imageRect.moveCenter(thumbRect.center());
+        const int cell = 5;
+        for (int y = imageRect.top(); y <= imageRect.bottom(); y += cell) {
+            for (int x = imageRect.left(); x <= imageRect.right(); x += cell) {
+                QRect cellRect = QRect(x, y, cell, cell) & imageRect;
+                bool dark = (((x - imageRect.left()) / cell + (y - imageRect.top()) / cell) % 2) != 0;
+                painter->fillRect(cellRect, dark ? CHECK_COLOR_2 : CHECK_COLOR_1);
+            }
+        }
+        painter->drawImage(imageRect, thumb);
+    }
+
+    // Прозрачность
+    QRect opacityRect(r.right() - LAYER_ITEM_MARGIN - LAYER_ITEM_OPACITY_LABEL_WIDTH, r.top(),
+                      LAYER_ITEM_OPACITY_LABEL_WIDTH, r.height());
+    QFont opacityFont = option.font;
+    opacityFont.setPixelSize(LAYER_ITEM_OPACITY_LABEL_FONT_SIZE);
+    painter->setFont(opacityFont);
+    painter->setPen(QColor(LAYER_ITEM_OPACITY_LABEL_COLOR));
+    const int opacity = int(index.data(LayerModel::OpacityRole).toFloat() * 100);
+    painter->drawText(opacityRect, Qt::AlignRight | Qt::AlignVCenter, QString("%1%").arg(opacity));
+
+    // Имя слоя
+    QRect nameRect(thumbRect.right() + 1 + LAYER_ITEM_SPACING, r.top(),
+                   opacityRect.left() - LAYER_ITEM_SPACING - thumbRect.right() - 1 - LAYER_ITEM_SPACING,
+                   r.height());
+    painter->setFont(option.font);
+    painter->setPen(QColor(LAYERS_PANEL_TEXT_COLOR));
+    const QString name = painter->fontMetrics().elidedText(index.data(Qt::DisplayRole).toString(),
+                                                           Qt::ElideRight, nameRect.width());
+    painter->drawText(nameRect, Qt::AlignLeft | Qt::AlignVCenter, name);
+
+    painter->restore();
+}
+
+QSize LayerItemDelegate::sizeHint(const QStyleOptionViewItem& option,
+                                  const QModelIndex& index) const
+{
+    Q_UNUSED(option)
+    Q_UNUSED(index)
+    return QSize(200, LAYER_ITEM_HEIGHT);
+}
+
+bool LayerItemDelegate::editorEvent(QEvent* event, QAbstractItemModel* model,
+                                    const QStyleOptionViewItem& option, const QModelIndex& index)
+{
+    if (event->type() != QEvent::MouseButtonRelease && event->type() != QEvent::MouseButtonPress)
+        return false;
+
+    QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(event);
+    if (mouseEvent->button() != Qt::LeftButton
+        || !checkBoxRect(option.rect).contains(mouseEvent->position().toPoint()))
+        return false;
+
+    // Нажатие поглощаем, чтобы клик по флажку не начинал перетаскивание
+    if (event->type() == QEvent::MouseButtonPress)
+        return true;
+
+    const bool visible = index.data(Qt::CheckStateRole).toInt() == Qt::Checked;
+    return model->setData(index, visible ? Qt::Unchecked : Qt::Checked, Qt::CheckStateRole);
+}
@@ -0,0 +1,79 @@
+#ifndef LAYERMODEL_H
+#define LAYERMODEL_H
+
+#include <QAbstractListModel>
+#include <QStyledItemDelegate>
+#include <QImage>
+#include <QTimer>
+#include <QSet>
+#include <QVector>
+#include "LayerManager.h"
+
+// Модель списка слоев поверх LayerManager.
+// Строка 0 - верхний слой, поэтому row и индекс слоя идут в обратном порядке.
+class LayerModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        OpacityRole = Qt::UserRole + 1,
+        ThumbnailRole,
+        LayerIndexRole,
+        LayerIdRole
+    };
+
+    explicit LayerModel(LayerManager* layerManager, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+    int rowFromLayerIndex(int layerIndex) const;
+    int layerIndexFromRow(int row) const;
+
+signals:
+    // Переключение видимости идет через команды, поэтому модель только сообщает о нем
+    void visibilityToggleRequested(LayerId layerId, bool visible);
+
+private slots:
+    void onLayerInserted(int layerIndex);
+    void onLayerRemoved(int layerIndex);
+    void onLayerMoved(int fromIndex, int toIndex);
+    void onLayersReset();
+    void onLayerPropertyChanged(int layerIndex, LayerProperty property);
+    void onLayerPixelsChanged(int layerIndex, const QRect& rect);
+    void flushThumbnails();
+
+private:
+    QImage thumbnail(int layerIndex) const;
+
+    LayerManager* m_layerManager;
+
+    // Кэш миниатюр по индексу слоя; пустое изображение - миниатюру нужно пересчитать
+    mutable QVector<QImage> m_thumbnails;
+    QSet<int> m_pendingThumbnails;
+    QTimer m_thumbnailTimer;
+};
+
+// Рисует строку слоя целиком, без дочерних виджетов
+class LayerItemDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit LayerItemDelegate(QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option,
+               const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option,
+                   const QModelIndex& index) const override;
+    bool editorEvent(QEvent* event, QAbstractItemModel* model,
+                     const QStyleOptionViewItem& option, const QModelIndex& index) override;
+
+private:
+    QRect checkBoxRect(const QRect& itemRect) const;
+};
+
+#endif // LAYERMODEL_H
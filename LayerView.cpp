@@ -20,7 +20,7 @@ LayerView::LayerView(LayerManager* layerManager,
     // Инициализация инструментов
     m_pencilTool = new PencilTool(m_layerManager, m_commandManager, m_colorManager, m_toolManager, this);
     m_fillTool = new FillTool(m_layerManager, m_commandManager, m_colorManager, m_toolManager, this);
-    m_eyedropperTool = new EyedropperTool(m_layerManager, m_colorManager, this);
+    m_eyedropperTool = new EyedropperTool(m_layerManager, m_colorManager, m_toolManager, this);
 
     m_brushtool = new BrushTool(m_layerManager, m_commandManager, m_colorManager, m_toolManager, this);
     m_erasertool = new EraserTool(m_layerManager, m_commandManager, m_toolManager, this);
@@ -28,8 +28,52 @@ LayerView::LayerView(LayerManager* layerManager,
     m_linetool = new LineTool(m_layerManager, m_commandManager, m_colorManager, m_toolManager, this);
     m_recttool = new RectTool(m_layerManager, m_commandManager, m_colorManager, m_toolManager, this);
     m_ellipsetool = new EllipseTool(m_layerManager, m_commandManager, m_colorManager, m_toolManager, this);
+
+    m_rectSelectTool = new SelectionTool(m_layerManager, SelectionShape::Rectangle, this);
+    m_ellipseSelectTool = new SelectionTool(m_layerManager, SelectionShape::Ellipse, this);
+    m_lassoTool = new SelectionTool(m_layerManager, SelectionShape::Lasso, this);
+    m_magicWandTool = new MagicWandTool(m_layerManager, m_toolManager, this);
+    m_transformTool = new TransformTool(m_layerManager, m_commandManager, this);
+    m_gradientTool = new GradientTool(m_layerManager, m_commandManager, m_colorManager, m_toolManager, this);
     updateCurrentTool();
 
+    for (Tool* tool : std::initializer_list<Tool*>{ m_pencilTool, m_fillTool, m_eyedropperTool, m_brushtool,
+                                                    m_erasertool, m_linetool, m_recttool, m_ellipsetool,
+                                                    m_rectSelectTool, m_ellipseSelectTool, m_lassoTool,
+                                                    m_transformTool, m_gradientTool }) {
+        connect(tool, &Tool::overlayChanged, this, [this](const QRect& rect) {
+            if (!rect.isEmpty())
+                updateImageRect(rect);
+        });
+    }
+
+    // Enter и Esc нужны трансформации
+    setFocusPolicy(Qt::ClickFocus);
+
+    // Наведение без нажатия нужно инструментам с подсказками (подсветка области заливки)
+    setMouseTracking(true);
+
+    // Движения мыши копятся и отдаются инструменту пачкой раз в кадр
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setTimerType(Qt::PreciseTimer);
+    m_flushTimer.setInterval(STROKE_FLUSH_INTERVAL_MS);
+    connect(&m_flushTimer, &QTimer::timeout, this, &LayerView::flushPendingSamples);
+
+    m_latencyClock.start();
+
+    // Муравьи сдвигаются по таймеру, пока выделение есть; перерисовываются только его границы
+    m_antsTimer.setInterval(SELECTION_ANTS_INTERVAL_MS);
+    connect(&m_antsTimer, &QTimer::timeout, this, &LayerView::advanceSelectionAnts);
+    if (m_layerManager) {
+        connect(m_layerManager, &LayerManager::selectionChanged, this, [this](const QRect& rect) {
+            updateImageRect(rect.adjusted(-1, -1, 1, 1));
+            if (m_layerManager->selection().isEmpty())
+                m_antsTimer.stop();
+            else if (!m_antsTimer.isActive())
+                m_antsTimer.start();
+        });
+    }
+
     if (m_toolManager) {
         connect(m_toolManager, &ToolManager::toolChanged, this, &LayerView::updateCurrentTool);
     }
@@ -37,7 +81,6 @@ LayerView::LayerView(LayerManager* layerManager,
 
 void LayerView::paintEvent(QPaintEvent* event)
 {
-    Q_UNUSED(event)
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
 
@@ -47,27 +90,28 @@ void LayerView::paintEvent(QPaintEvent* event)
         return;
     }
 
-    const Layer* layer0 = m_layerManager->layerAt(0);
-    QSize canvasSize = layer0->image().size();
+    // Перерисовываем только область, которая действительно изменилась
+    const QRect dirty = event->rect();
 
-    // Вычисляем масштаб для сохранения пропорций
-    float scaleX = float(width()) / canvasSize.width();
-    float scaleY = float(height()) / canvasSize.height();
-    float scale = qMin(scaleX, scaleY);
-
-    // Размер изображения на виджете
-    int imgWidth = int(canvasSize.width() * scale);
-    int imgHeight = int(canvasSize.height() * scale);
+    // Задержка между получением отсчета и кадром, в котором он нарисован. Считается
+    // только отсчет, уже отданный инструменту: прочие перерисовки его еще не показывают
+    if (m_firstFlushedInput >= 0) {
+        const qreal latency = qreal(m_latencyClock.elapsed() - m_firstFlushedInput);
+        m_inputLatencyMs = m_inputLatencyMs > 0.0 ? m_inputLatencyMs * 0.9 + latency * 0.1 : latency;
+        m_firstFlushedInput = -1;
+    }
 
-    // Координаты для центрирования
-    int offsetX = (width() - imgWidth) / 2;
-    int offsetY = (height() - imgHeight) / 2;
+    float scale = 1.0f;
+    QPoint offset;
+    canvasGeometry(scale, offset);
 
     const int checkerSize = 10;
     QBrush checkerBrush(CHECK_COLOR_1, Qt::SolidPattern);
     QBrush checkerBrush2(CHECK_COLOR_2, Qt::SolidPattern);
-    for (int y = 0; y < height(); y += checkerSize) {
-        for (int x = 0; x < width(); x += checkerSize) {
+    const int firstX = dirty.left() / checkerSize * checkerSize;
+    const int firstY = dirty.top() / checkerSize * checkerSize;
+    for (int y = firstY; y <= dirty.bottom(); y += checkerSize) {
+        for (int x = firstX; x <= dirty.right(); x += checkerSize) {
             QRect rect(x, y, checkerSize, checkerSize);
             if (((x/10 + y/10) % 2) == 0)
                 painter.fillRect(rect, checkerBrush);
@@ -76,53 +120,203 @@ void LayerView::paintEvent(QPaintEvent* event)
         }
     }
 
+    // Часть изображения, попадающая в перерисовываемую область
+    const QSize canvasSize = m_layerManager->layerAt(0)->image().size();
+    QRectF source(QPointF(dirty.left() - offset.x(), dirty.top() - offset.y()) / scale,
+                  QSizeF(dirty.width(), dirty.height()) / scale);
+    source = source.adjusted(-1, -1, 1, 1) & QRectF(QPointF(0, 0), QSizeF(canvasSize));
+    if (source.isEmpty())
+        return;
+
     painter.save();
-    painter.translate(offsetX, offsetY);
+    painter.setClipRect(dirty);
+    painter.translate(offset);
     painter.scale(scale, scale);
 
+    const StrokeBuffer* stroke = m_currentTool ? m_currentTool->strokeBuffer() : nullptr;
+    if (stroke && !stroke->isActive())
+        stroke = nullptr;
+
     for (int i = 0; i < m_layerManager->layerCount(); ++i) {
         const Layer* layer = m_layerManager->layerAt(i);
         if (!layer || !layer->isVisible()) continue;
         painter.setOpacity(layer->opacity());
-        painter.drawImage(0, 0, layer->image());
+
+        // Незавершенный штрих и предпросмотр коррекции накладываются
+        // на копию видимого участка своего слоя
+        const bool strokeLayer = stroke && layer->id() == stroke->layerId();
+        const bool previewLayer = m_previewLayerId != 0 && layer->id() == m_previewLayerId;
+        if (strokeLayer || previewLayer) {
+            const QRect area = source.toAlignedRect() & layer->image().rect();
+            QImage live = layer->image().copy(area);
+            if (strokeLayer)
+                stroke->composite(live, area.topLeft(), area,
+                                  m_currentTool->strokeMaskedBySelection() ? &m_layerManager->selection() : nullptr);
+            if (previewLayer) {
+                const QImage before = live.copy();
+                m_previewAdjustment.apply(live, live.rect());
+                m_layerManager->selection().applyMask(live, before, area.topLeft());
+            }
+            painter.drawImage(area.topLeft(), live);
+            continue;
+        }
+        painter.drawImage(source, layer->image(), source);
+    }
+
+    painter.setOpacity(1.0);
+    paintSelection(painter);
+
+    if (m_currentTool) {
+        painter.setOpacity(1.0);
+        m_currentTool->paintOverlay(painter);
+    }
+
+    // Прогноз штриха живет только на экране и заменяется при каждом новом кадре ввода
+    if (m_stroking && m_currentTool && !m_prediction.isEmpty()) {
+        painter.setOpacity(1.0);
+        m_currentTool->paintPrediction(painter, m_prediction);
     }
 
     painter.restore();
+
+    if (SHOW_INPUT_LATENCY) {
+        painter.setPen(Qt::red);
+        painter.drawText(rect().adjusted(8, 8, -8, -8), Qt::AlignLeft | Qt::AlignTop,
+                         QString("Задержка: %1 мс, прогноз: -%2 мс")
+                             .arg(m_inputLatencyMs, 0, 'f', 1)
+                             .arg(m_predictedLeadMs, 0, 'f', 1));
+    }
 }
 
+void LayerView::paintSelection(QPainter& painter) const
+{
+    const Selection& selection = m_layerManager->selection();
+    if (selection.isEmpty())
+        return;
 
-QPoint LayerView::toLayerCoordinates(const QPoint& pos) const
+    // Контур строится один раз при изменении выделения, здесь он только обводится
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(QPen(Qt::white, 0));
+    painter.drawPath(selection.outline());
+
+    QPen dashes(Qt::black, 0);
+    dashes.setDashPattern({ SELECTION_ANTS_DASH, SELECTION_ANTS_DASH });
+    dashes.setDashOffset(m_antsOffset);
+    painter.setPen(dashes);
+    painter.drawPath(selection.outline());
+    painter.restore();
+}
+
+void LayerView::advanceSelectionAnts()
+{
+    const Selection& selection = m_layerManager->selection();
+    if (selection.isEmpty()) {
+        m_antsTimer.stop();
+        return;
+    }
+
+    m_antsOffset = (m_antsOffset + 1) % (2 * SELECTION_ANTS_DASH);
+    updateImageRect(selection.bounds().adjusted(-1, -1, 1, 1));
+}
+
+void LayerView::canvasGeometry(float& scale, QPoint& offset) const
+{
+    scale = 1.0f;
+    offset = QPoint();
+
+    if (!m_layerManager || m_layerManager->layerCount() == 0)
+        return;
+
+    QSize canvasSize = m_layerManager->layerAt(0)->image().size();
+
+    // Вычисляем масштаб для сохранения пропорций
+    float scaleX = float(width()) / canvasSize.width();
+    float scaleY = float(height()) / canvasSize.height();
+    scale = qMin(scaleX, scaleY);
+
+    // Размер изображения на виджете
+    int imgWidth = int(canvasSize.width() * scale);
+    int imgHeight = int(canvasSize.height() * scale);
+
+    // Координаты для центрирования
+    offset = QPoint((width() - imgWidth) / 2, (height() - imgHeight) / 2);
+}
+
+void LayerView::updateImageRect(const QRect& imageRect)
+{
+    if (imageRect.isEmpty()) {
+        update();
+        return;
+    }
+
+    float scale = 1.0f;
+    QPoint offset;
+    canvasGeometry(scale, offset);
+
+    QRectF widgetRect(QPointF(imageRect.topLeft()) * scale + offset,
+                      QSizeF(imageRect.size()) * scale);
+    update(widgetRect.toAlignedRect().adjusted(-1, -1, 1, 1));
+}
+
+
+QPointF LayerView::toLayerCoordinates(const QPointF& pos) const
 {
     if (!m_layerManager || m_layerManager->activeLayerIndex() < 0)
         return pos;
 
     const Layer* layer = m_layerManager->layerAt(m_layerManager->activeLayerIndex());
     QSize canvasSize = layer->image().size();
-    QSize widgetSize = size();
 
-    float scaleX = float(widgetSize.width()) / canvasSize.width();
-    float scaleY = float(widgetSize.height()) / canvasSize.height();
-    float scale = qMin(scaleX, scaleY);
+    float scale = 1.0f;
+    QPoint offset;
+    canvasGeometry(scale, offset);
 
-    int imgWidth = int(canvasSize.width() * scale);
-    int imgHeight = int(canvasSize.height() * scale);
+    qreal x = (pos.x() - offset.x()) / scale;
+    qreal y = (pos.y() - offset.y()) / scale;
 
-    int offsetX = (widgetSize.width() - imgWidth) / 2;
-    int offsetY = (widgetSize.height() - imgHeight) / 2;
+    x = qBound(0.0, x, qreal(canvasSize.width() - 1));
+    y = qBound(0.0, y, qreal(canvasSize.height() - 1));
 
-    int x = int((pos.x() - offsetX) / scale);
-    int y = int((pos.y() - offsetY) / scale);
+    return QPointF(x, y);
+}
 
-    x = qBound(0, x, canvasSize.width() - 1);
-    y = qBound(0, y, canvasSize.height() - 1);
+StrokeSample LayerView::makeSample(const QMouseEvent* event) const
+{
+    StrokeSample sample;
+    sample.pos = toLayerCoordinates(event->position());
+    sample.timestamp = qint64(event->timestamp());
+    return sample;
+}
 
-    return QPoint(x, y);
+StrokeSample LayerView::makeSample(const QTabletEvent* event) const
+{
+    StrokeSample sample;
+    sample.pos = toLayerCoordinates(event->position());
+    sample.timestamp = qint64(event->timestamp());
+    sample.pressure = event->pressure();
+    sample.xTilt = event->xTilt();
+    sample.yTilt = event->yTilt();
+    return sample;
+}
+
+void LayerView::cancelToolOperation()
+{
+    if (m_currentTool)
+        m_currentTool->cancel();
 }
 
 void LayerView::updateCurrentTool()
 {
     if (!m_toolManager) return;
 
+    // Недоставленные отсчеты принадлежат прежнему инструменту
+    flushPendingSamples();
+
+    // Незаконченная операция прежнего инструмента применяется
+    Tool* previous = m_currentTool;
+
     switch (m_toolManager->currentTool()) {
     case ToolType::Pencil:
         m_currentTool = m_pencilTool;
@@ -148,34 +342,197 @@ void LayerView::updateCurrentTool()
     case ToolType::Ellipse:
         m_currentTool = m_ellipsetool;
         break;
+    case ToolType::RectSelect:
+        m_currentTool = m_rectSelectTool;
+        break;
+    case ToolType::EllipseSelect:
+        m_currentTool = m_ellipseSelectTool;
+        break;
+    case ToolType::Lasso:
+        m_currentTool = m_lassoTool;
+        break;
+    case ToolType::MagicWand:
+        m_currentTool = m_magicWandTool;
+        break;
+    case ToolType::Transform:
+        m_currentTool = m_transformTool;
+        break;
+    case ToolType::Gradient:
+        m_currentTool = m_gradientTool;
+        break;
     default:
         m_currentTool = nullptr;
         break;
     }
+
+    if (previous && previous != m_currentTool)
+        previous->deactivate();
+
+    // Подсказки прежнего инструмента больше не рисуются
+    update();
+}
+
+void LayerView::setAdjustmentPreview(LayerId layerId, const ColorAdjustment& adjustment)
+{
+    m_previewLayerId = adjustment.isIdentity() ? 0 : layerId;
+    m_previewAdjustment = adjustment;
+    update();
+}
+
+void LayerView::clearAdjustmentPreview()
+{
+    if (m_previewLayerId == 0) return;
+    m_previewLayerId = 0;
+    m_previewAdjustment = ColorAdjustment();
+    update();
+}
+
+void LayerView::keyPressEvent(QKeyEvent* event)
+{
+    if (m_currentTool && m_currentTool->keyPress(event))
+        return;
+    QWidget::keyPressEvent(event);
 }
 
 void LayerView::mousePressEvent(QMouseEvent* event)
 {
-    if (m_currentTool) {
-        QPoint layerPos = toLayerCoordinates(event->pos());
-        m_currentTool->mousePress(layerPos);
-    }
+    if (m_currentTool)
+        beginStroke(makeSample(event));
 }
 
 void LayerView::mouseMoveEvent(QMouseEvent* event)
 {
-    if (m_currentTool) {
-        QPoint layerPos = toLayerCoordinates(event->pos());
-        m_currentTool->mouseMove(layerPos);
-    }
+    if (!m_currentTool)
+        return;
+
+    if (m_stroking)
+        appendSample(makeSample(event));
+    else
+        m_currentTool->hoverMove(makeSample(event));
 }
 
 void LayerView::mouseReleaseEvent(QMouseEvent* event)
 {
-    if (m_currentTool) {
-        QPoint layerPos = toLayerCoordinates(event->pos());
-        m_currentTool->mouseRelease(layerPos);
+    if (m_currentTool)
+        endStroke(makeSample(event));
+}
+
+void LayerView::tabletEvent(QTabletEvent* event)
+{
+    // Принятое событие не превращается в синтезированное событие мыши,
+    // поэтому каждый отсчет планшета приходит ровно один раз
+    if (!m_currentTool) {
+        event->ignore();
+        return;
     }
+
+    switch (event->type()) {
+    case QEvent::TabletPress:
+        beginStroke(makeSample(event));
+        break;
+    case QEvent::TabletMove:
+        // Движение пера над планшетом без касания не рисует
+        if (m_stroking)
+            appendSample(makeSample(event));
+        else
+            m_currentTool->hoverMove(makeSample(event));
+        break;
+    case QEvent::TabletRelease:
+        if (m_stroking)
+            endStroke(makeSample(event));
+        break;
+    default:
+        event->ignore();
+        return;
+    }
+    event->accept();
+}
+
+void LayerView::beginStroke(const StrokeSample& sample)
+{
+    m_pendingSamples.clear();
+    m_currentTool->mousePress(sample);
+
+    m_stroking = true;
+    m_predictor.reset();
+    m_predictor.addSample(sample);
+}
+
+void LayerView::appendSample(const StrokeSample& sample)
+{
+    if (m_firstUnpaintedInput < 0)
+        m_firstUnpaintedInput = m_latencyClock.elapsed();
+
+    m_pendingSamples.append(sample);
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void LayerView::endStroke(const StrokeSample& sample)
+{
+    flushPendingSamples();
+    m_stroking = false;
+    clearPrediction();
+    m_currentTool->mouseRelease(sample);
+}
+
+void LayerView::flushPendingSamples()
+{
+    m_flushTimer.stop();
+    if (m_pendingSamples.isEmpty())
+        return;
+
+    QVector<StrokeSample> samples;
+    samples.swap(m_pendingSamples);
+
+    if (m_firstFlushedInput < 0)
+        m_firstFlushedInput = m_firstUnpaintedInput;
+    m_firstUnpaintedInput = -1;
+
+    if (m_currentTool)
+        m_currentTool->mouseMove(samples);
+
+    if (m_stroking) {
+        m_predictor.addSamples(samples);
+        updatePrediction();
+    }
+}
+
+void LayerView::updatePrediction()
+{
+    if (!STROKE_PREDICTION_ENABLED)
+        return;
+
+    const QPolygonF previous = m_prediction;
+    m_prediction = m_predictor.predict(STROKE_PREDICTION_HORIZON_MS);
+    m_predictedLeadMs = m_prediction.isEmpty() ? 0.0 : m_predictor.predictedLeadMs(STROKE_PREDICTION_HORIZON_MS);
+
+    // Старый прогноз стирается той же перерисовкой, что выводит новый
+    const QRect bounds = predictionBounds(previous) | predictionBounds(m_prediction);
+    if (!bounds.isEmpty())
+        updateImageRect(bounds);
+    if (SHOW_INPUT_LATENCY)
+        update(QRect(0, 0, width(), 40));
+}
+
+void LayerView::clearPrediction()
+{
+    if (m_prediction.isEmpty())
+        return;
+
+    const QRect bounds = predictionBounds(m_prediction);
+    m_prediction.clear();
+    m_predictedLeadMs = 0.0;
+    updateImageRect(bounds);
+}
+
+QRect LayerView::predictionBounds(const QPolygonF& path) const
+{
+    if (path.isEmpty())
+        return QRect();
+
+    const int margin = (m_toolManager ? m_toolManager->brushSize() : 1) + 2;
+    return path.boundingRect().toAlignedRect().adjusted(-margin, -margin, margin, margin);
 }
 
 QImage LayerView::getCombinedImage() const
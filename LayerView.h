@@ -2,11 +2,18 @@
 
 #include <QWidget>
 #include <QMouseEvent>
+#include <QTabletEvent>
+#include <QKeyEvent>
+#include <QTimer>
+#include <QVector>
+#include <QElapsedTimer>
 #include "LayerManager.h"
 #include "ToolManager.h"
 #include "CommandSystem.h"
 #include "ColorManager.h"
 #include "Tools.h"
+#include "StrokePredictor.h"
+#include "ColorAdjustment.h"
 
 class LayerView : public QWidget
 {
@@ -19,18 +26,50 @@ public:
                        QWidget* parent = nullptr);
 
     QImage getCombinedImage() const;
+
+    // Перерисовывает только часть виджета, соответствующую rect изображения
+    void updateImageRect(const QRect& imageRect);
+
+    // Сглаженное время от получения отсчета до его появления на экране
+    qreal inputLatencyMs() const { return m_inputLatencyMs; }
+    // На сколько прогноз опережает последний реальный отсчет
+    qreal predictedLeadMs() const { return m_predictedLeadMs; }
+
+    // Предпросмотр коррекции: считается при отрисовке и только для видимой части слоя
+    void setAdjustmentPreview(LayerId layerId, const ColorAdjustment& adjustment);
+    void clearAdjustmentPreview();
+
+    // Бросает незаконченную операцию текущего инструмента
+    void cancelToolOperation();
 protected:
     void paintEvent(QPaintEvent* event) override;
 
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
     void mouseReleaseEvent(QMouseEvent* event) override;
+    void tabletEvent(QTabletEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
 
 private slots:
     void updateCurrentTool();
+    // Передает инструменту все отсчеты, накопленные с прошлого кадра
+    void flushPendingSamples();
 
 private:
-    QPoint toLayerCoordinates(const QPoint& pos) const;
+    QPointF toLayerCoordinates(const QPointF& pos) const;
+    StrokeSample makeSample(const QMouseEvent* event) const;
+    StrokeSample makeSample(const QTabletEvent* event) const;
+
+    // Общий путь для мыши и планшета
+    void beginStroke(const StrokeSample& sample);
+    void appendSample(const StrokeSample& sample);
+    void endStroke(const StrokeSample& sample);
+    void updatePrediction();
+    void clearPrediction();
+    void paintSelection(QPainter& painter) const;
+    void advanceSelectionAnts();
+    QRect predictionBounds(const QPolygonF& path) const;
+    void canvasGeometry(float& scale, QPoint& offset) const;
 
     LayerManager* m_layerManager = nullptr;
     ToolManager* m_toolManager = nullptr;
@@ -48,6 +87,32 @@ private:
     RectTool* m_recttool = nullptr;
     EllipseTool* m_ellipsetool = nullptr;
 
+    SelectionTool* m_rectSelectTool = nullptr;
+    SelectionTool* m_ellipseSelectTool = nullptr;
+    SelectionTool* m_lassoTool = nullptr;
+    MagicWandTool* m_magicWandTool = nullptr;
+    TransformTool* m_transformTool = nullptr;
+    GradientTool* m_gradientTool = nullptr;
+
 
     Tool* m_currentTool = nullptr;
+
+    QVector<StrokeSample> m_pendingSamples;
+    QTimer m_flushTimer;
+
+    bool m_stroking = false;
+    StrokePredictor m_predictor;
+    QPolygonF m_prediction;
+
+    QElapsedTimer m_latencyClock;
+    qint64 m_firstUnpaintedInput = -1;  // первый отсчет, еще не переданный инструменту
+    qint64 m_firstFlushedInput = -1;    // первый переданный отсчет, еще не выведенный на экран
+    qreal m_inputLatencyMs = 0.0;
+    qreal m_predictedLeadMs = 0.0;
+
+    QTimer m_antsTimer;
+    int m_antsOffset = 0;
+
+    LayerId m_previewLayerId = 0;
+    ColorAdjustment m_previewAdjustment;
 };
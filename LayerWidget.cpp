@@ -1,36 +1,50 @@
 #include "LayerWidget.h"
 #include "Commands.h"
 #include <QLabel>
-#include <QListWidgetItem>
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QDrag>
 #include <QMimeData>
 #include <QApplication>
 #include <QMouseEvent>
-#include <QCheckBox>
 #include <QPainter>
 #include "Config.h"
 
-LayerListWidget::LayerListWidget(QWidget* parent)
-    : QListWidget(parent)
+LayerListView::LayerListView(QWidget* parent)
+    : QListView(parent)
 {
     setSelectionMode(QAbstractItemView::SingleSelection);
     setDragDropMode(QAbstractItemView::InternalMove);
     setDefaultDropAction(Qt::MoveAction);
+    // Все строки одной высоты: раскладка не зависит от числа слоев
+    setUniformItemSizes(true);
+    setMouseTracking(true);
 }
 
-void LayerListWidget::mousePressEvent(QMouseEvent* event)
+int LayerListView::currentRow() const
+{
+    QModelIndex index = currentIndex();
+    return index.isValid() ? index.row() : -1;
+}
+
+void LayerListView::setCurrentRow(int row)
+{
+    if (!model()) return;
+    setCurrentIndex(model()->index(row, 0));
+}
+
+void LayerListView::mousePressEvent(QMouseEvent* event)
 {
     if (event->button() == Qt::LeftButton) {
         m_dragStartPosition = event->pos();
     }
-    QListWidget::mousePressEvent(event);
+    QListView::mousePressEvent(event);
 }
 
-void LayerListWidget::mouseMoveEvent(QMouseEvent* event)
+void LayerListView::mouseMoveEvent(QMouseEvent* event)
 {
     if (!(event->buttons() & Qt::LeftButton)) {
+        QListView::mouseMoveEvent(event);
         return;
     }
 
@@ -38,8 +52,8 @@ void LayerListWidget::mouseMoveEvent(QMouseEvent* event)
         return;
     }
 
-    QListWidgetItem* item = itemAt(m_dragStartPosition);
-    if (!item) {
+    QModelIndex index = indexAt(m_dragStartPosition);
+    if (!index.isValid()) {
         return;
     }
 
@@ -47,7 +61,7 @@ void LayerListWidget::mouseMoveEvent(QMouseEvent* event)
     QDrag* drag = new QDrag(this);
     QMimeData* mimeData = new QMimeData;
 
-    int dragIndex = row(item);
+    int dragIndex = index.row();
     mimeData->setData("application/x-layer-index", QByteArray::number(dragIndex));
 
     drag->setMimeData(mimeData);
@@ -57,48 +71,46 @@ void LayerListWidget::mouseMoveEvent(QMouseEvent* event)
 
     QPainter painter(&pixmap);
     painter.setPen(Qt::white);
-    painter.drawText(pixmap.rect(), Qt::AlignCenter, item->text());
+    painter.drawText(pixmap.rect(), Qt::AlignCenter, index.data(Qt::DisplayRole).toString());
     painter.end();
 
     drag->setPixmap(pixmap);
     drag->setHotSpot(QPoint(10, 10));
 
-    Qt::DropAction dropAction = drag->exec(Qt::MoveAction);
+    drag->exec(Qt::MoveAction);
 }
 
-void LayerListWidget::dragEnterEvent(QDragEnterEvent* event)
+void LayerListView::dragEnterEvent(QDragEnterEvent* event)
 {
     if (event->mimeData()->hasFormat("application/x-layer-index")) {
         event->acceptProposedAction();
     }
 }
 
-void LayerListWidget::dragMoveEvent(QDragMoveEvent* event)
+void LayerListView::dragMoveEvent(QDragMoveEvent* event)
 {
     if (event->mimeData()->hasFormat("application/x-layer-index")) {
         event->acceptProposedAction();
 
-        QListWidgetItem* item = itemAt(event->pos());
-        if (item) {
-            setCurrentItem(item);
+        QModelIndex index = indexAt(event->position().toPoint());
+        if (index.isValid()) {
+            setCurrentIndex(index);
         }
     }
 }
 
-void LayerListWidget::dropEvent(QDropEvent* event)
+void LayerListView::dropEvent(QDropEvent* event)
 {
     if (event->mimeData()->hasFormat("application/x-layer-index")) {
         int sourceIndex = event->mimeData()->data("application/x-layer-index").toInt();
-        QListWidgetItem* targetItem = itemAt(event->pos());
+        QModelIndex targetIndex = indexAt(event->position().toPoint());
 
-        if (!targetItem) {
+        if (!targetIndex.isValid()) {
             event->ignore();
             return;
         }
 
-        int targetIndex = row(targetItem);
-
-        emit layerMoved(sourceIndex, targetIndex);
+        emit layerMoved(sourceIndex, targetIndex.row());
 
         event->acceptProposedAction();
     }
@@ -108,6 +120,7 @@ LayerWidget::LayerWidget(LayerManager* layerManager, CommandManager* comManager,
     : QWidget(parent)
     , m_layerManager(layerManager)
     , m_commandManager(comManager)
+    , m_layerModel(nullptr)
     , m_layerList(nullptr)
     , m_addButton(nullptr)
     , m_removeButton(nullptr)
@@ -118,10 +131,20 @@ LayerWidget::LayerWidget(LayerManager* layerManager, CommandManager* comManager,
     setupConnections();
 
     if (m_layerManager) {
-        connect(m_layerManager, &LayerManager::layersChanged,
+        // Полная перестройка списка нужна только при структурных изменениях
+        connect(m_layerManager, &LayerManager::layerInserted,
                 this, &LayerWidget::updateLayerList);
-        connect(m_layerManager, &LayerManager::activeLayerChanged,
+        connect(m_layerManager, &LayerManager::layerRemoved,
                 this, &LayerWidget::updateLayerList);
+        connect(m_layerManager, &LayerManager::layerMoved,
+                this, &LayerWidget::updateLayerList);
+        connect(m_layerManager, &LayerManager::layersReset,
+                this, &LayerWidget::updateLayerList);
+
+        connect(m_layerManager, &LayerManager::layerPropertyChanged,
+                this, &LayerWidget::onLayerPropertyChanged);
+        connect(m_layerManager, &LayerManager::activeLayerChanged,
+                this, &LayerWidget::onActiveLayerChanged);
     }
 }
 void LayerWidget::setupUI()
@@ -165,19 +188,17 @@ void LayerWidget::setupUI()
     buttonLayout->addWidget(m_mergeButton);
     buttonLayout->addStretch();
 
-    m_layerList = new LayerListWidget();
-    m_layerList->setAlternatingRowColors(true);
+    m_layerModel = new LayerModel(m_layerManager, this);
+
+    m_layerList = new LayerListView();
+    m_layerList->setModel(m_layerModel);
+    m_layerList->setItemDelegate(new LayerItemDelegate(m_layerList));
+    // Фон строк, выделение и разделители рисует LayerItemDelegate
     m_layerList->setStyleSheet(QString(
-                                   "QListWidget { background-color: %1; border: 1px solid %2; }"
-                                   "QListWidget::item { border-bottom: 1px solid %3; padding: 2px; }"
-                                   "QListWidget::item:selected { background-color: %4; }"
-                                   "QListWidget::item:hover { background-color: %5; }"
+                                   "QListView { background-color: %1; border: 1px solid %2; }"
                                    )
                                    .arg(LAYER_LIST_BG_COLOR)
                                    .arg(LAYER_LIST_BORDER_COLOR)
-                                   .arg(LAYER_LIST_ITEM_BORDER_BOTTOM)
-                                   .arg(LAYER_LIST_ITEM_SELECTED_BG)
-                                   .arg(LAYER_LIST_ITEM_HOVER_BG)
                                );
 
     QHBoxLayout* opacityLayout = new QHBoxLayout();
@@ -212,10 +233,12 @@ void LayerWidget::setupConnections()
             this, &LayerWidget::onMergeWithNextClicked);
 
 
-    connect(m_layerList, &QListWidget::currentRowChanged,
+    connect(m_layerList->selectionModel(), &QItemSelectionModel::currentRowChanged,
             this, &LayerWidget::onLayerSelectionChanged);
-    connect(m_layerList, &LayerListWidget::layerMoved,
+    connect(m_layerList, &LayerListView::layerMoved,
             this, &LayerWidget::onLayerMoved);
+    connect(m_layerModel, &LayerModel::visibilityToggleRequested,
+            this, &LayerWidget::onLayerVisibilityChanged);
 
     connect(m_opacitySlider, &QSlider::sliderPressed,
             this, &LayerWidget::onOpacitySliderPressed);
@@ -223,10 +246,6 @@ void LayerWidget::setupConnections()
             this, &LayerWidget::onOpacitySliderValueChanged);
     connect(m_opacitySlider, &QSlider::sliderReleased,
             this, &LayerWidget::onOpacitySliderReleased);
-
-    connect(m_layerManager, &LayerManager::layersChanged,
-            this, &LayerWidget::updateOpacitySlider);
-
 }
 
 void LayerWidget::onOpacitySliderValueChanged(int value)
@@ -235,12 +254,7 @@ void LayerWidget::onOpacitySliderValueChanged(int value)
     if (listIndex < 0 || !m_layerManager) return;
 
     int realIndex = getRealLayerIndex(listIndex);
-    Layer* layer = m_layerManager->layerAt(realIndex);
-    if (!layer) return;
-
-    layer->setOpacity(value / 100.0f);
-    m_layerManager->layersChanged();
-    updateLayerList();
+    m_layerManager->setLayerOpacity(realIndex, value / 100.0f);
 }
 
 void LayerWidget::onOpacitySliderPressed()
@@ -270,7 +284,7 @@ void LayerWidget::onOpacitySliderReleased()
     if (qAbs(newOpacity - m_startOpacity) > 0.001f)
     {
         ChangeLayerOpacityCommand* command =
-            new ChangeLayerOpacityCommand(m_layerManager, realIndex,m_startOpacity, newOpacity);
+            new ChangeLayerOpacityCommand(m_layerManager, layer->id(), m_startOpacity, newOpacity);
         m_commandManager->ExecuteCommand(command);
     }
 }
@@ -325,9 +339,10 @@ void LayerWidget::onRemoveLayerClicked()
         return;
     }
 
-    QString layerName = m_layerManager->layerAt(realIndex)->name();
+    Layer* layer = m_layerManager->layerAt(realIndex);
+    if (!layer) return;
 
-    DeleteLayerCommand* command = new DeleteLayerCommand(m_layerManager, realIndex);
+    DeleteLayerCommand* command = new DeleteLayerCommand(m_layerManager, layer->id());
     m_commandManager->ExecuteCommand(command);
 }
 
@@ -338,9 +353,10 @@ void LayerWidget::onDuplicateLayerClicked()
     int listIndex = m_layerList->currentRow();
     if (listIndex < 0) return;
 
-    int realIndex = getRealLayerIndex(listIndex);
+    Layer* layer = m_layerManager->layerAt(getRealLayerIndex(listIndex));
+    if (!layer) return;
 
-    DuplicateLayerCommand* command = new DuplicateLayerCommand(m_layerManager, realIndex);
+    DuplicateLayerCommand* command = new DuplicateLayerCommand(m_layerManager, layer->id());
     m_commandManager->ExecuteCommand(command);
 }
 
@@ -362,12 +378,12 @@ void LayerWidget::onLayerSelectionChanged()
     }
 }
 
-void LayerWidget::onLayerVisibilityChanged(int realIndex, bool visible)
+void LayerWidget::onLayerVisibilityChanged(LayerId layerId, bool visible)
 {
     if (!m_layerManager || !m_commandManager) return;
-    Layer* layer = m_layerManager->layerAt(realIndex);
+    Layer* layer = m_layerManager->layerById(layerId);
     if (layer && layer->isVisible() != visible) {
-        ToggleLayerVisibilityCommand* command = new ToggleLayerVisibilityCommand(m_layerManager, realIndex);
+        ToggleLayerVisibilityCommand* command = new ToggleLayerVisibilityCommand(m_layerManager, layerId);
         m_commandManager->ExecuteCommand(command);
     }
 }
@@ -387,69 +403,14 @@ void LayerWidget::updateLayerList()
 {
     if (!m_layerManager) return;
 
-    int currentListRow = m_layerList->currentRow();
-
-    m_layerList->blockSignals(true);
-    m_layerList->clear();
-
-    for (int i = m_layerManager->layerCount() - 1; i >= 0; --i) {
-        const Layer* layer = m_layerManager->layerAt(i);
-        if (!layer) continue;
-
-        QListWidgetItem* item = new QListWidgetItem();
-
-        QWidget* itemWidget = new QWidget();
-        QHBoxLayout* itemLayout = new QHBoxLayout(itemWidget);
-        itemLayout->setContentsMargins(4, 2, 4, 2);
-        itemLayout->setSpacing(4);
-
-        QLabel* dragIcon = new QLabel("☰");
-        dragIcon->setStyleSheet("color: #666; font-size: 12px;");
-        dragIcon->setFixedSize(16, 16);
-        dragIcon->setAlignment(Qt::AlignCenter);
-
-        QCheckBox* visibilityCheck = new QCheckBox();
-        visibilityCheck->setChecked(layer->isVisible());
-        visibilityCheck->setFixedSize(20, 20);
-
-        connect(visibilityCheck, &QCheckBox::toggled, this, [this, i](bool visible) {
-            onLayerVisibilityChanged(i, visible);
-        });
-
-        QLabel* nameLabel = new QLabel(layer->name());
-        nameLabel->setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
-
-        QLabel* opacityLabel = new QLabel(QString("%1%").arg(int(layer->opacity() * 100)));
-        opacityLabel->setStyleSheet("color: #666; font-size: 10px;");
-        opacityLabel->setFixedWidth(30);
-
-        itemLayout->addWidget(dragIcon);
-        itemLayout->addWidget(visibilityCheck);
-        itemLayout->addWidget(nameLabel, 1);
-        itemLayout->addWidget(opacityLabel);
-        itemLayout->addStretch();
-
-        itemWidget->setLayout(itemLayout);
-
-        item->setSizeHint(QSize(200, 30));
-
-        item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled);
-
-        m_layerList->addItem(item);
-        m_layerList->setItemWidget(item, itemWidget);
-
-        if (i == m_layerManager->activeLayerIndex()) {
-            item->setSelected(true);
-        }
-    }
-
-    if (currentListRow >= 0 && currentListRow < m_layerList->count()) {
-        m_layerList->setCurrentRow(currentListRow);
-    }
-
-    SetRow(getRealLayerIndex(m_layerManager->activeLayerIndex()));
-    m_layerList->blockSignals(false);
+    // Строки обновляет LayerModel, здесь остается только синхронизировать выделение
+    SetRow(getListIndexFromReal(m_layerManager->activeLayerIndex()));
+    updateOpacitySlider();
+    updateButtons();
+}
 
+void LayerWidget::updateButtons()
+{
     bool hasLayers = m_layerManager->layerCount() > 0;
     bool hasSelection = m_layerList->currentRow() >= 0;
 
@@ -465,6 +426,29 @@ void LayerWidget::updateLayerList()
     m_opacitySlider->setEnabled(hasSelection);
 }
 
+void LayerWidget::onLayerPropertyChanged(int realIndex, LayerProperty property)
+{
+    if (!m_layerManager) return;
+
+    // Строку перерисовывает модель, виджету нужно только обновить ползунок
+    if (property == LayerProperty::Opacity && realIndex == m_layerManager->activeLayerIndex()) {
+        updateOpacitySlider();
+    }
+}
+
+void LayerWidget::onActiveLayerChanged(int realIndex)
+{
+    if (!m_layerManager) return;
+
+    int listIndex = getListIndexFromReal(realIndex);
+    if (listIndex < 0 || listIndex >= m_layerModel->rowCount())
+        return;
+
+    SetRow(listIndex);
+    updateOpacitySlider();
+    updateButtons();
+}
+
 int LayerWidget::getRealLayerIndex(int listIndex) const
 {
     if (!m_layerManager || listIndex < 0) return -1;
@@ -513,7 +497,7 @@ void LayerWidget::onRenameLayerClicked()
         return;
 
     RenameLayerCommand* cmd =
-        new RenameLayerCommand(m_layerManager, realIndex, layer->name(), newName);
+        new RenameLayerCommand(m_layerManager, layer->id(), layer->name(), newName);
     m_commandManager->ExecuteCommand(cmd);
 }
 
@@ -532,7 +516,10 @@ void LayerWidget::onMergeWithNextClicked()
         return;
     }
 
+    Layer* layer = m_layerManager->layerAt(realIndex);
+    if (!layer) return;
+
     MergeLayerWithNextCommand* cmd =
-        new MergeLayerWithNextCommand(m_layerManager, realIndex);
+        new MergeLayerWithNextCommand(m_layerManager, layer->id());
     m_commandManager->ExecuteCommand(cmd);
 }
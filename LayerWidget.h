@@ -2,7 +2,7 @@
 #define LAYERWIDGET_H
 
 #include <QWidget>
-#include <QListWidget>
+#include <QListView>
 #include <QToolButton>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -10,14 +10,18 @@
 #include <QCheckBox>
 #include <QLabel>
 #include "LayerManager.h"
+#include "LayerModel.h"
 #include "CommandSystem.h"
 
-class LayerListWidget : public QListWidget
+class LayerListView : public QListView
 {
     Q_OBJECT
 
 public:
-    LayerListWidget(QWidget* parent = nullptr);
+    LayerListView(QWidget* parent = nullptr);
+
+    int currentRow() const;
+    void setCurrentRow(int row);
 
 signals:
     void layerMoved(int fromIndex, int toIndex);
@@ -46,11 +50,13 @@ private slots:
     void onRemoveLayerClicked();
     void onDuplicateLayerClicked();
     void onLayerSelectionChanged();
-    void onLayerVisibilityChanged(int realIndex, bool visible);
+    void onLayerVisibilityChanged(LayerId layerId, bool visible);
     void onLayerMoved(int fromIndex, int toIndex);
 
 
     void updateLayerList();
+    void onLayerPropertyChanged(int realIndex, LayerProperty property);
+    void onActiveLayerChanged(int realIndex);
     void onOpacitySliderPressed();
     void onOpacitySliderValueChanged(int value);
     void onOpacitySliderReleased();
@@ -61,13 +67,15 @@ private slots:
 private:
     void setupUI();
     void setupConnections();
+    void updateButtons();
     int getRealLayerIndex(int listIndex) const;
     int getListIndexFromReal(int realIndex) const;
 
     LayerManager* m_layerManager;
     CommandManager* m_commandManager;
 
-    LayerListWidget* m_layerList;
+    LayerModel* m_layerModel;
+    LayerListView* m_layerList;
     QToolButton* m_addButton;
     QToolButton* m_removeButton;
     QToolButton* m_duplicateButton;
@@ -13,6 +13,15 @@
 #include <QFileDialog>
 #include <QInputDialog>
 #include "Config.h"
+#include "Commands.h"
+#include "Filters.h"
+#include "AdjustmentDialog.h"
+#include "Resample.h"
+#include "Parallel.h"
+#include <QProgressDialog>
+#include <QThread>
+#include <QTimer>
+#include <memory>
 
 
 MainWindow::MainWindow(QWidget *parent)
@@ -58,6 +67,84 @@ MainWindow::MainWindow(QWidget *parent)
     QAction* exportAction = new QAction("Экспорт...", this);
     fileMenu->addAction(exportAction);
     connect(exportAction, &QAction::triggered, this, &MainWindow::exportCanvas);
+
+    QMenu* imageMenu = menuBar()->addMenu("Изображение");
+
+    QAction* imageSizeAction = new QAction("Размер изображения...", this);
+    imageMenu->addAction(imageSizeAction);
+    connect(imageSizeAction, &QAction::triggered, this, &MainWindow::imageSizeDialog);
+
+    QAction* canvasSizeAction = new QAction("Размер холста...", this);
+    imageMenu->addAction(canvasSizeAction);
+    connect(canvasSizeAction, &QAction::triggered, this, &MainWindow::canvasSizeDialog);
+
+    QAction* cropAction = new QAction("Кадрировать по выделению", this);
+    imageMenu->addAction(cropAction);
+    connect(cropAction, &QAction::triggered, this, &MainWindow::cropToSelection);
+    connect(imageMenu, &QMenu::aboutToShow, this, [this, cropAction]() {
+        cropAction->setEnabled(layerManager && !layerManager->selection().isEmpty());
+    });
+
+    imageMenu->addSeparator();
+    addOrientationActions(imageMenu, false);
+
+    QMenu* layerMenu = menuBar()->addMenu("Слой");
+    QMenu* layerOrientMenu = layerMenu->addMenu("Поворот и отражение");
+    addOrientationActions(layerOrientMenu, true);
+
+    QMenu* filterMenu = layerMenu->addMenu("Фильтры");
+
+    QAction* gaussianAction = new QAction("Размытие по Гауссу...", this);
+    filterMenu->addAction(gaussianAction);
+    connect(gaussianAction, &QAction::triggered, this, &MainWindow::gaussianBlurDialog);
+
+    QAction* boxBlurAction = new QAction("Размытие по квадрату...", this);
+    filterMenu->addAction(boxBlurAction);
+    connect(boxBlurAction, &QAction::triggered, this, &MainWindow::boxBlurDialog);
+
+    QAction* motionBlurAction = new QAction("Размытие в движении...", this);
+    filterMenu->addAction(motionBlurAction);
+    connect(motionBlurAction, &QAction::triggered, this, &MainWindow::motionBlurDialog);
+
+    QAction* unsharpAction = new QAction("Нерезкая маска...", this);
+    filterMenu->addAction(unsharpAction);
+    connect(unsharpAction, &QAction::triggered, this, &MainWindow::unsharpMaskDialog);
+
+    QMenu* adjustMenu = layerMenu->addMenu("Коррекция");
+
+    QAction* levelsAction = new QAction("Уровни...", this);
+    adjustMenu->addAction(levelsAction);
+    connect(levelsAction, &QAction::triggered, this, [this]() {
+        runAdjustmentDialog("Уровни",
+                            { { "Черная точка", 0, 254, 0 }, { "Белая точка", 1, 255, 255 },
+                              { "Гамма, %", 10, 500, 100 },
+                              { "Выход: черный", 0, 255, 0 }, { "Выход: белый", 0, 255, 255 } },
+                            [](const QVector<int>& v) {
+                                return ColorAdjustment::levels(v[0], qMax(v[0] + 1, v[1]), v[2] / 100.0, v[3], v[4]);
+                            });
+    });
+
+    QAction* curvesAction = new QAction("Кривые...", this);
+    adjustMenu->addAction(curvesAction);
+    connect(curvesAction, &QAction::triggered, this, [this]() {
+        runAdjustmentDialog("Кривые",
+                            { { "Тени", 0, 255, 64 }, { "Средние тона", 0, 255, 128 }, { "Света", 0, 255, 192 } },
+                            [](const QVector<int>& v) { return ColorAdjustment::curves(v[0], v[1], v[2]); });
+    });
+
+    QAction* hueAction = new QAction("Оттенок/Насыщенность...", this);
+    adjustMenu->addAction(hueAction);
+    connect(hueAction, &QAction::triggered, this, [this]() {
+        runAdjustmentDialog("Оттенок/Насыщенность",
+                            { { "Оттенок", -180, 180, 0 }, { "Насыщенность", -100, 100, 0 }, { "Яркость", -100, 100, 0 } },
+                            [](const QVector<int>& v) { return ColorAdjustment::hueSaturation(v[0], v[1], v[2]); });
+    });
+
+    QAction* invertAction = new QAction("Инвертировать", this);
+    adjustMenu->addAction(invertAction);
+    connect(invertAction, &QAction::triggered, this, [this]() {
+        applyColorAdjustment(ColorAdjustment::invert());
+    });
 }
 
 void MainWindow::saveAs()
@@ -83,6 +170,7 @@ void MainWindow::createNewCanvas(int w, int h)
 
     QSize size(w, h);
 
+    LayerManager::BatchScope batch(layerManager);
     layerManager->ClearLayers();
     commandManager->Clear();
 
@@ -304,7 +392,21 @@ void MainWindow::SetupNewLayout()
 
     mainLayout->addWidget(mainSplitter, 1);
 
-    connect(layerManager, &LayerManager::layersChanged,
+    connect(layerManager, &LayerManager::layerPixelsChanged,
+            this, &MainWindow::onLayerPixelsChanged);
+    // Имя слоя на холст не влияет: перерисовка нужна только для видимости и прозрачности
+    connect(layerManager, &LayerManager::layerPropertyChanged,
+            this, [this](int, LayerProperty property) {
+                if (property != LayerProperty::Name)
+                    onLayersChanged();
+            });
+    connect(layerManager, &LayerManager::layerInserted,
+            this, &MainWindow::onLayersChanged);
+    connect(layerManager, &LayerManager::layerRemoved,
+            this, &MainWindow::onLayersChanged);
+    connect(layerManager, &LayerManager::layerMoved,
+            this, &MainWindow::onLayersChanged);
+    connect(layerManager, &LayerManager::layersReset,
             this, &MainWindow::onLayersChanged);
 }
 
@@ -316,6 +418,15 @@ void MainWindow::onLayersChanged()
     }
 }
 
+void MainWindow::onLayerPixelsChanged(int index, const QRect& rect)
+{
+    Q_UNUSED(index)
+    if (layerView)
+    {
+        layerView->updateImageRect(rect);
+    }
+}
+
 void MainWindow::InitializeLayers()
 {
     if (!layerManager) return;
@@ -361,10 +472,12 @@ void MainWindow::SetShortcuts()
         }
     });
 
+    // G переключает заливку и градиент
     QShortcut *fillShortcut = new QShortcut(QKeySequence("G"), this);
     connect(fillShortcut, &QShortcut::activated, this, [this]() {
         if (toolManager) {
-            toolManager->setCurrentTool(ToolType::Fill);
+            toolManager->setCurrentTool(toolManager->currentTool() == ToolType::Fill ? ToolType::Gradient
+                                                                                      : ToolType::Fill);
         }
     });
 
@@ -383,6 +496,51 @@ void MainWindow::SetShortcuts()
         }
     });
 
+    // Выделение: M переключает прямоугольник, овал и лассо по кругу
+    QShortcut *selectShortcut = new QShortcut(QKeySequence("M"), this);
+    connect(selectShortcut, &QShortcut::activated, this, [this]() {
+        if (!toolManager) return;
+        switch (toolManager->currentTool()) {
+        case ToolType::RectSelect:
+            toolManager->setCurrentTool(ToolType::EllipseSelect);
+            break;
+        case ToolType::EllipseSelect:
+            toolManager->setCurrentTool(ToolType::Lasso);
+            break;
+        default:
+            toolManager->setCurrentTool(ToolType::RectSelect);
+            break;
+        }
+    });
+
+    QShortcut *magicWandShortcut = new QShortcut(QKeySequence("W"), this);
+    connect(magicWandShortcut, &QShortcut::activated, this, [this]() {
+        if (toolManager) {
+            toolManager->setCurrentTool(ToolType::MagicWand);
+        }
+    });
+
+    QShortcut *transformShortcut = new QShortcut(QKeySequence("Ctrl+T"), this);
+    connect(transformShortcut, &QShortcut::activated, this, [this]() {
+        if (toolManager) {
+            toolManager->setCurrentTool(ToolType::Transform);
+        }
+    });
+
+    QShortcut *selectAllShortcut = new QShortcut(QKeySequence("Ctrl+A"), this);
+    connect(selectAllShortcut, &QShortcut::activated, this, [this]() {
+        if (layerManager && layerManager->layerCount() > 0) {
+            const QSize size = layerManager->layerAt(0)->image().size();
+            layerManager->setSelection(Selection::fromRect(QRect(QPoint(0, 0), size), size));
+        }
+    });
+
+    QShortcut *deselectShortcut = new QShortcut(QKeySequence("Ctrl+D"), this);
+    connect(deselectShortcut, &QShortcut::activated, this, [this]() {
+        if (layerManager)
+            layerManager->clearSelection();
+    });
+
     // Слои
     QShortcut *newLayerShortcut = new QShortcut(QKeySequence("Ctrl+Shift+N"), this);
     connect(newLayerShortcut, &QShortcut::activated, this, [this]() {
@@ -395,6 +553,10 @@ void MainWindow::SetShortcuts()
 
 void MainWindow::HandleUndo()
 {
+    // Незаконченное преобразование держит снимок слоя, который история сейчас поменяет
+    if (layerView)
+        layerView->cancelToolOperation();
+
     if (commandManager->Undo())
     {
         if (layerView)
@@ -404,6 +566,9 @@ void MainWindow::HandleUndo()
 
 void MainWindow::HandleRedo()
 {
+    if (layerView)
+        layerView->cancelToolOperation();
+
     if (commandManager->Redo())
     {
         if (layerView)
@@ -489,8 +654,304 @@ void MainWindow::openImageAsNewProject(const QString& filename)
 
     if (!layer) return;
 
-    layer->setImage(img);
+    lm->setLayerImage(activeIndex, img);
+}
+
+void MainWindow::applyLayerFilter(int reach, const std::function<void(QImage&)>& filter)
+{
+    Layer* layer = layerManager ? layerManager->activeLayer() : nullptr;
+    if (!layer) return;
+
+    const QImage& image = layer->image();
+    const Selection& selection = layerManager->selection();
+    const QRect target = selection.isEmpty() ? image.rect() : selection.bounds() & image.rect();
+    if (target.isEmpty()) return;
 
-    lm->layersChanged();
+    // Фильтр читает соседей области, поэтому копия берется с запасом
+    const QRect area = target.adjusted(-reach, -reach, reach, reach) & image.rect();
+    QImage work = image.copy(area);
+
+    filter(work);
+
+    const QImage before = image.copy(target);
+    QImage after = work.copy(target.translated(-area.topLeft()));
+    selection.applyMask(after, before, target.topLeft());
+
+    QVector<ImagePatch> patches;
+    patches.append({ target.topLeft(), before, after });
+    commandManager->ExecuteCommand(new DrawCommand(layerManager, layer->id(), patches));
+}
+
+void MainWindow::gaussianBlurDialog()
+{
+    bool ok;
+    const double radius = QInputDialog::getDouble(this, "Размытие по Гауссу", "Радиус:", 2.0, 0.1, FILTER_MAX_RADIUS, 1, &ok);
+    if (!ok) return;
+
+    applyLayerFilter(Filters::gaussianReach(radius), [radius](QImage& image) {
+        Filters::gaussianBlur(image, radius);
+    });
 }
 
+void MainWindow::boxBlurDialog()
+{
+    bool ok;
+    const int radius = QInputDialog::getInt(this, "Размытие по квадрату", "Радиус:", 2, 1, FILTER_MAX_RADIUS, 1, &ok);
+    if (!ok) return;
+
+    applyLayerFilter(radius, [radius](QImage& image) {
+        Filters::boxBlur(image, radius);
+    });
+}
+
+void MainWindow::motionBlurDialog()
+{
+    bool ok;
+    const int length = QInputDialog::getInt(this, "Размытие в движении", "Длина:", 10, 2, FILTER_MAX_RADIUS, 1, &ok);
+    if (!ok) return;
+    const double angle = QInputDialog::getDouble(this, "Размытие в движении", "Угол:", 0.0, -180.0, 180.0, 1, &ok);
+    if (!ok) return;
+
+    applyLayerFilter(length / 2 + 1, [length, angle](QImage& image) {
+        Filters::motionBlur(image, length, angle);
+    });
+}
+
+void MainWindow::unsharpMaskDialog()
+{
+    bool ok;
+    const double radius = QInputDialog::getDouble(this, "Нерезкая маска", "Радиус:", 2.0, 0.1, FILTER_MAX_RADIUS, 1, &ok);
+    if (!ok) return;
+    const int amount = QInputDialog::getInt(this, "Нерезкая маска", "Эффект, %:", 100, 1, 500, 1, &ok);
+    if (!ok) return;
+    const int threshold = QInputDialog::getInt(this, "Нерезкая маска", "Порог:", 0, 0, 255, 1, &ok);
+    if (!ok) return;
+
+    applyLayerFilter(Filters::gaussianReach(radius), [=](QImage& image) {
+        Filters::unsharpMask(image, radius, amount / 100.0, threshold);
+    });
+}
+
+void MainWindow::runAdjustmentDialog(const QString& title, const QVector<AdjustmentDialog::Parameter>& parameters,
+                                     const AdjustmentDialog::Builder& builder)
+{
+    const Layer* layer = layerManager ? layerManager->activeLayer() : nullptr;
+    if (!layer || !layerView) return;
+
+    const LayerId layerId = layer->id();
+    AdjustmentDialog dialog(title, parameters, builder, this);
+    connect(&dialog, &AdjustmentDialog::adjustmentChanged, this, [this, layerId](const ColorAdjustment& adjustment) {
+        layerView->setAdjustmentPreview(layerId, adjustment);
+    });
+    layerView->setAdjustmentPreview(layerId, dialog.adjustment());
+
+    const bool accepted = dialog.exec() == QDialog::Accepted;
+    layerView->clearAdjustmentPreview();
+    if (accepted)
+        applyColorAdjustment(dialog.adjustment());
+}
+
+void MainWindow::applyColorAdjustment(const ColorAdjustment& adjustment)
+{
+    const Layer* layer = layerManager ? layerManager->activeLayer() : nullptr;
+    if (!layer || adjustment.isIdentity()) return;
+
+    const QImage& image = layer->image();
+    const Selection selection = layerManager->selection();
+    const QRect target = selection.isEmpty() ? image.rect() : selection.bounds() & image.rect();
+    if (target.isEmpty()) return;
+
+    // Полное разрешение считается в фоновом потоке над копией; слой меняется
+    // только по завершении, одной командой истории
+    const LayerId layerId = layer->id();
+    const QSize layerSize = image.size();
+    const QImage before = image.copy(target);
+    auto result = std::make_shared<QImage>(before.copy());
+    auto progress = std::make_shared<std::atomic<int>>(0);
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+
+    // Окно модально сразу: пока идет работа, слой нельзя править
+    QProgressDialog* dialog = new QProgressDialog("Применение коррекции...", "Отмена", 0, target.height(), this);
+    dialog->setWindowModality(Qt::WindowModal);
+    dialog->setMinimumDuration(0);
+    connect(dialog, &QProgressDialog::canceled, this, [cancel]() { *cancel = true; });
+
+    QTimer* poll = new QTimer(dialog);
+    poll->setInterval(ADJUSTMENT_PROGRESS_INTERVAL_MS);
+    connect(poll, &QTimer::timeout, dialog, [dialog, progress]() { dialog->setValue(progress->load()); });
+    poll->start();
+
+    QThread* worker = QThread::create([adjustment, result, progress, cancel]() {
+        adjustment.apply(*result, result->rect(), progress.get(), cancel.get());
+    });
+    connect(worker, &QThread::finished, this, [=]() {
+        worker->deleteLater();
+        dialog->deleteLater();
+        if (cancel->load()) return;
+
+        // Слой могли удалить или изменить до того, как окно стало модальным:
+        // результат по старым пикселям тогда затер бы правку и испортил историю
+        const Layer* current = layerManager->layerById(layerId);
+        if (!current || current->image().size() != layerSize) return;
+        if (current->image().copy(target) != before) return;
+
+        QImage after = *result;
+        selection.applyMask(after, before, target.topLeft());
+        QVector<ImagePatch> patches;
+        patches.append({ target.topLeft(), before, after });
+        commandManager->ExecuteCommand(new DrawCommand(layerManager, layerId, patches));
+    });
+    dialog->show();
+    worker->start();
+}
+
+void MainWindow::transformAllLayers(const std::function<QImage(const QImage&)>& transform)
+{
+    if (!layerManager || layerManager->layerCount() == 0) return;
+
+    const int count = layerManager->layerCount();
+    QVector<LayerId> ids(count);
+    QVector<QImage> sources(count);
+    QVector<QImage> results(count);
+    for (int i = 0; i < count; ++i) {
+        ids[i] = layerManager->layerAt(i)->id();
+        sources[i] = layerManager->layerAt(i)->image();
+    }
+
+    // Слои считаются одновременно; внутри каждый еще делится на полосы строк
+    Parallel::forRanges(count, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            results[i] = transform(sources[i]);
+    });
+
+    QHash<LayerId, QImage> before;
+    QHash<LayerId, QImage> after;
+    for (int i = 0; i < count; ++i) {
+        before.insert(ids[i], sources[i]);
+        after.insert(ids[i], results[i]);
+    }
+    commandManager->ExecuteCommand(new ReplaceLayerImagesCommand(layerManager, before, after));
+}
+
+void MainWindow::imageSizeDialog()
+{
+    if (!layerManager || layerManager->layerCount() == 0) return;
+    const QSize current = layerManager->layerAt(0)->image().size();
+
+    bool ok;
+    const int w = QInputDialog::getInt(this, "Размер изображения", "Ширина:", current.width(),
+                                       MIN_CANVAS_SIZE, MAX_CANVAS_SIZE, 1, &ok);
+    if (!ok) return;
+    // По умолчанию пропорции сохраняются
+    const int proportional = qBound(MIN_CANVAS_SIZE, qRound(qreal(current.height()) * w / current.width()), MAX_CANVAS_SIZE);
+    const int h = QInputDialog::getInt(this, "Размер изображения", "Высота:", proportional,
+                                       MIN_CANVAS_SIZE, MAX_CANVAS_SIZE, 1, &ok);
+    if (!ok) return;
+
+    const QSize size(w, h);
+    if (size == current) return;
+
+    transformAllLayers([size](const QImage& image) {
+        return Resample::lanczos(image, size);
+    });
+}
+
+void MainWindow::canvasSizeDialog()
+{
+    if (!layerManager || layerManager->layerCount() == 0) return;
+    const QSize current = layerManager->layerAt(0)->image().size();
+
+    bool ok;
+    const int w = QInputDialog::getInt(this, "Размер холста", "Ширина:", current.width(),
+                                       MIN_CANVAS_SIZE, MAX_CANVAS_SIZE, 1, &ok);
+    if (!ok) return;
+    const int h = QInputDialog::getInt(this, "Размер холста", "Высота:", current.height(),
+                                       MIN_CANVAS_SIZE, MAX_CANVAS_SIZE, 1, &ok);
+    if (!ok) return;
+
+    // Привязка: какая точка старого холста остается на месте
+    const QStringList anchors = { "Сверху слева", "Сверху", "Сверху справа",
+                                  "Слева", "Центр", "Справа",
+                                  "Снизу слева", "Снизу", "Снизу справа" };
+    const QString anchorName = QInputDialog::getItem(this, "Размер холста", "Привязка:", anchors, 4, false, &ok);
+    if (!ok) return;
+
+    const QSize size(w, h);
+    if (size == current) return;
+
+    const int anchor = anchors.indexOf(anchorName);
+    const QPoint offset((size.width() - current.width()) * (anchor % 3) / 2,
+                        (size.height() - current.height()) * (anchor / 3) / 2);
+
+    transformAllLayers([size, offset](const QImage& image) {
+        QImage result(size, QImage::Format_ARGB32_Premultiplied);
+        result.fill(Qt::transparent);
+        QPainter painter(&result);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(offset, image);
+        return result;
+    });
+}
+
+void MainWindow::addOrientationActions(QMenu* menu, bool activeLayerOnly)
+{
+    const QVector<QPair<QString, Orientation>> entries = {
+        { "Повернуть на 90° по часовой", Orientation::Rotate90 },
+        { "Повернуть на 90° против часовой", Orientation::Rotate270 },
+        { "Повернуть на 180°", Orientation::Rotate180 },
+        { "Отразить по горизонтали", Orientation::FlipHorizontal },
+        { "Отразить по вертикали", Orientation::FlipVertical }
+    };
+
+    QVector<QAction*> quarterTurns;
+    for (const auto& entry : entries) {
+        QAction* action = new QAction(entry.first, this);
+        menu->addAction(action);
+        const Orientation orientation = entry.second;
+        connect(action, &QAction::triggered, this, [this, orientation, activeLayerOnly]() {
+            orientLayers(orientation, activeLayerOnly);
+        });
+        if (ImageOrientation::swapsSize(entry.second))
+            quarterTurns.append(action);
+    }
+
+    // Один слой нельзя повернуть на 90, если холст не квадратный: его размер разошелся бы с остальными
+    if (activeLayerOnly) {
+        connect(menu, &QMenu::aboutToShow, this, [this, quarterTurns]() {
+            const Layer* layer = layerManager ? layerManager->activeLayer() : nullptr;
+            const bool square = layer && layer->image().width() == layer->image().height();
+            for (QAction* action : quarterTurns)
+                action->setEnabled(square);
+        });
+    }
+}
+
+void MainWindow::orientLayers(Orientation orientation, bool activeLayerOnly)
+{
+    if (!layerManager || layerManager->layerCount() == 0) return;
+
+    QVector<LayerId> ids;
+    if (activeLayerOnly) {
+        const Layer* layer = layerManager->activeLayer();
+        if (!layer) return;
+        if (ImageOrientation::swapsSize(orientation) && layer->image().width() != layer->image().height())
+            return;
+        ids.append(layer->id());
+    } else {
+        for (int i = 0; i < layerManager->layerCount(); ++i)
+            ids.append(layerManager->layerAt(i)->id());
+    }
+
+    commandManager->ExecuteCommand(new OrientLayersCommand(layerManager, ids, orientation));
+}
+
+void MainWindow::cropToSelection()
+{
+    if (!layerManager || layerManager->layerCount() == 0) return;
+
+    const QRect canvas = layerManager->layerAt(0)->image().rect();
+    const QRect rect = layerManager->selection().bounds() & canvas;
+    if (rect.isEmpty() || rect == canvas) return;
+
+    commandManager->ExecuteCommand(new CropCommand(layerManager, rect));
+}
@@ -8,8 +8,12 @@
 #include "LayerWidget.h"
 #include "ToolManager.h"
 #include "ColorManager.h"
+#include "AdjustmentDialog.h"
+#include "ImageOrientation.h"
+#include <functional>
 
 QT_BEGIN_NAMESPACE
+class QMenu;
 namespace Ui
 {
 class MainWindow;
@@ -35,13 +39,34 @@ private slots:
     void HandleUndo();
     void HandleRedo();
     void onLayersChanged();
+    void onLayerPixelsChanged(int index, const QRect& rect);
     void saveAs();
+    void gaussianBlurDialog();
+    void boxBlurDialog();
+    void motionBlurDialog();
+    void unsharpMaskDialog();
+    void imageSizeDialog();
+    void canvasSizeDialog();
+    void cropToSelection();
 
 private:
     void SetShortcuts();
     void SetupNewLayout();
     void InitializeLayers();
     void exportCanvas();
+    // Применяет фильтр к активному слою (в пределах выделения) одной командой истории
+    void applyLayerFilter(int reach, const std::function<void(QImage&)>& filter);
+    // Коррекция с предпросмотром на холсте, пока открыт диалог
+    void runAdjustmentDialog(const QString& title, const QVector<AdjustmentDialog::Parameter>& parameters,
+                             const AdjustmentDialog::Builder& builder);
+    // Применяет коррекцию к активному слою в фоне, с индикатором и отменой
+    void applyColorAdjustment(const ColorAdjustment& adjustment);
+    // Заменяет изображения всех слоев результатом transform (считаются параллельно)
+    // одной командой истории
+    void transformAllLayers(const std::function<QImage(const QImage&)>& transform);
+    // Повороты и отражения всех слоев или только активного
+    void addOrientationActions(QMenu* menu, bool activeLayerOnly);
+    void orientLayers(Orientation orientation, bool activeLayerOnly);
 
     Ui::MainWindow *ui;
     LayerManager* layerManager;
@@ -0,0 +1,118 @@
+#include "PaintSession.h"
+#include "LayerManager.h"
+#include "Commands.h"
+#include <cstring>
+
+bool PaintSession::begin(LayerManager* layers, const QRect& area)
+{
+    m_layers = nullptr;
+    m_changed = QRegion();
+
+    Layer* active = layers ? layers->layerAt(layers->activeLayerIndex()) : nullptr;
+    if (!active)
+        return false;
+
+    m_layers = layers;
+    m_layerId = active->id();
+    m_selection = layers->selection();
+
+    const QImage& image = active->image();
+    if (!area.isNull()) {
+        // Границы правки известны заранее: копируется только этот участок
+        m_clip = area & image.rect();
+        if (!m_selection.isEmpty())
+            m_clip &= m_selection.bounds();
+        m_before = image.copy(m_clip);
+        m_beforeOffset = m_clip.topLeft();
+    } else if (m_selection.isEmpty()) {
+        // Без выделения снимок разделяет данные со слоем и копируется при первой записи
+        m_clip = image.rect();
+        m_before = image;
+        m_beforeOffset = QPoint();
+    } else {
+        // С выделением копируется только участок под ним
+        m_clip = m_selection.bounds() & image.rect();
+        m_before = image.copy(m_clip);
+        m_beforeOffset = m_clip.topLeft();
+    }
+    return true;
+}
+
+Layer* PaintSession::layer() const
+{
+    return m_layers ? m_layers->layerById(m_layerId) : nullptr;
+}
+
+int PaintSession::layerIndex() const
+{
+    return m_layers ? m_layers->indexOf(m_layerId) : -1;
+}
+
+void PaintSession::restore(const QRect& rect)
+{
+    Layer* target = layer();
+    if (!target)
+        return;
+
+    QImage& image = target->image();
+    const QRect area = rect & QRect(m_beforeOffset, m_before.size()) & image.rect();
+    if (area.isEmpty())
+        return;
+
+    const qsizetype bytes = qsizetype(area.width()) * 4;
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        std::memcpy(image.scanLine(y) + area.left() * 4,
+                    m_before.constScanLine(y - m_beforeOffset.y()) + (area.left() - m_beforeOffset.x()) * 4,
+                    bytes);
+    }
+}
+
+void PaintSession::commitPixels(const QRect& rect)
+{
+    Layer* target = layer();
+    const QRect area = rect & m_clip;
+    if (!target || area.isEmpty())
+        return;
+
+    m_selection.applyMask(target->image(), m_before, m_beforeOffset, area);
+
+    m_changed += area;
+    // Множество мелких участков штриха сводится к их общим границам
+    if (m_changed.rectCount() > 256)
+        m_changed = m_changed.boundingRect();
+
+    m_layers->notifyPixelsChanged(layerIndex(), area);
+}
+
+void PaintSession::finish(CommandManager* commands)
+{
+    Layer* target = layer();
+    if (target && commands && !m_changed.isEmpty()) {
+        QVector<ImagePatch> patches;
+        for (const QRect& rect : m_changed) {
+            patches.append({ rect.topLeft(),
+                             m_before.copy(rect.translated(-m_beforeOffset)),
+                             target->image().copy(rect) });
+        }
+        commands->ExecuteCommand(new DrawCommand(m_layers, m_layerId, patches));
+    }
+
+    m_layers = nullptr;
+    m_before = QImage();
+    m_changed = QRegion();
+}
+
+void PaintSession::cancel()
+{
+    if (layer() && !m_changed.isEmpty()) {
+        LayerManager::BatchScope batch(m_layers);
+        for (const QRect& rect : m_changed) {
+            restore(rect);
+            m_layers->notifyPixelsChanged(layerIndex(), rect);
+        }
+    }
+
+    m_layers = nullptr;
+    m_before = QImage();
+    m_changed = QRegion();
+}
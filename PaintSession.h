@@ -0,0 +1,50 @@
+#ifndef PAINTSESSION_H
+#define PAINTSESSION_H
+
+#include <QImage>
+#include <QRegion>
+#include "Layer.h"
+#include "Selection.h"
+
+class LayerManager;
+class CommandManager;
+
+// Одна правка активного слоя инструментом: от нажатия до отпускания.
+// Держит снимок слоя только под выделением (или весь слой, если выделения нет),
+// ограничивает рисование границами выделения, применяет маску к измененным
+// участкам и в конце кладет в историю только эти участки.
+class PaintSession
+{
+public:
+    // false, если активного слоя нет. Непустой area ограничивает правку и снимок этим
+    // прямоугольником (штрих, границы которого уже известны)
+    bool begin(LayerManager* layers, const QRect& area = QRect());
+    bool isActive() const { return m_layers != nullptr; }
+
+    Layer* layer() const;
+    int layerIndex() const;
+
+    // Куда инструменту разрешено рисовать (границы выделения или весь слой)
+    QRect clip() const { return m_clip; }
+
+    // Возвращает в rect пиксели, бывшие до начала правки
+    void restore(const QRect& rect);
+    // Накладывает маску выделения на rect и сообщает об изменении пикселей
+    void commitPixels(const QRect& rect);
+
+    // Кладет измененные участки в историю и завершает правку
+    void finish(CommandManager* commands);
+    // Откатывает все изменения без записи в историю
+    void cancel();
+
+private:
+    LayerManager* m_layers = nullptr;
+    LayerId m_layerId = 0;
+    Selection m_selection;
+    QRect m_clip;
+    QImage m_before;
+    QPoint m_beforeOffset;
+    QRegion m_changed;
+};
+
+#endif // PAINTSESSION_H
@@ -0,0 +1,46 @@
+#include "Parallel.h"
+#include <QThreadPool>
+#include <QSemaphore>
+#include <atomic>
+
+namespace Parallel
+{
+
+void forRanges(int count, int grain, const std::function<void(int begin, int end)>& body)
+{
+    if (count <= 0)
+        return;
+
+    grain = qMax(1, grain);
+    const int chunks = (count + grain - 1) / grain;
+
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const int helpers = qMin(chunks, pool->maxThreadCount()) - 1;
+    if (helpers <= 0) {
+        body(0, count);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        for (int chunk = next.fetch_add(1); chunk < chunks; chunk = next.fetch_add(1)) {
+            const int begin = chunk * grain;
+            body(begin, qMin(count, begin + grain));
+        }
+    };
+
+    // tryStart не ставит задачу в очередь: если пул занят, куски доделает текущий поток,
+    // и вложенный вызов из потока пула не может зависнуть
+    QSemaphore done;
+    int started = 0;
+    for (int i = 0; i < helpers; ++i) {
+        if (!pool->tryStart([&]() { work(); done.release(); }))
+            break;
+        ++started;
+    }
+
+    work();
+    done.acquire(started);
+}
+
+}
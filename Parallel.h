@@ -0,0 +1,13 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+namespace Parallel
+{
+    // Делит [0, count) на куски по grain и выполняет body(begin, end) в пуле потоков.
+    // Вызывающий поток тоже берет куски; возврат - когда готовы все.
+    void forRanges(int count, int grain, const std::function<void(int begin, int end)>& body);
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,43 @@
+#ifndef PIXELOPS_H
+#define PIXELOPS_H
+
+#include <QtGlobal>
+#include <QRgb>
+
+// Целочисленные операции над упакованными premultiplied ARGB32: два канала
+// обрабатываются одним умножением, как в растеризаторе Qt
+namespace PixelOps
+{
+    // x * a / 255 для всех четырех каналов, a в 0..255
+    inline quint32 byteMul(quint32 x, quint32 a)
+    {
+        quint32 t = (x & 0xff00ff) * a;
+        t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+        t &= 0xff00ff;
+
+        x = ((x >> 8) & 0xff00ff) * a;
+        x = x + ((x >> 8) & 0xff00ff) + 0x800080;
+        x &= 0xff00ff00;
+        return x | t;
+    }
+
+    // (x * a + y * b) / 256, a + b = 256
+    inline quint32 interpolate256(quint32 x, quint32 a, quint32 y, quint32 b)
+    {
+        quint32 t = (x & 0xff00ff) * a + (y & 0xff00ff) * b;
+        t >>= 8;
+        t &= 0xff00ff;
+
+        x = ((x >> 8) & 0xff00ff) * a + ((y >> 8) & 0xff00ff) * b;
+        x &= 0xff00ff00;
+        return x | t;
+    }
+
+    // src поверх dst
+    inline quint32 sourceOver(quint32 dst, quint32 src)
+    {
+        return src + byteMul(dst, 255 - qAlpha(src));
+    }
+}
+
+#endif // PIXELOPS_H
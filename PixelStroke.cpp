@@ -0,0 +1,106 @@
+#include "PixelStroke.h"
+
+QRect PixelStroke::begin(StrokeBuffer& stroke, const QPoint& start, int size, quint32 scale, bool pixelPerfect)
+{
+    m_last = start;
+    m_plotted = start;
+    m_hasPending = false;
+    m_pixelPerfect = pixelPerfect;
+    return plot(stroke, start, size, scale);
+}
+
+QRect PixelStroke::lineTo(StrokeBuffer& stroke, const QPoint& end, int size, quint32 scale)
+{
+    QRect dirty;
+    int x = m_last.x();
+    int y = m_last.y();
+    const int dx = qAbs(end.x() - x);
+    const int dy = -qAbs(end.y() - y);
+    const int sx = x < end.x() ? 1 : -1;
+    const int sy = y < end.y() ? 1 : -1;
+    int error = dx + dy;
+
+    // Начальный пиксель уже поставлен концом прошлой линии
+    while (x != end.x() || y != end.y()) {
+        const int e2 = 2 * error;
+        if (e2 >= dy) {
+            error += dy;
+            x += sx;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            y += sy;
+        }
+        dirty |= push(stroke, QPoint(x, y), size, scale);
+    }
+
+    m_last = end;
+    return dirty;
+}
+
+QRect PixelStroke::finish(StrokeBuffer& stroke)
+{
+    if (!m_hasPending)
+        return QRect();
+    m_hasPending = false;
+    return plot(stroke, m_pending, 1, m_pendingScale);
+}
+
+QRect PixelStroke::push(StrokeBuffer& stroke, const QPoint& pos, int size, quint32 scale)
+{
+    if (!m_pixelPerfect || size != 1) {
+        // Нажим увеличил кисть: отложенный пиксель ставится, иначе в линии будет разрыв
+        QRect dirty = finish(stroke);
+        return dirty | plot(stroke, pos, size, scale);
+    }
+
+    if (!m_hasPending) {
+        m_pending = pos;
+        m_pendingScale = scale;
+        m_hasPending = true;
+        return QRect();
+    }
+
+    // Отложенный пиксель - угол L, если новый стоит по диагонали от последнего поставленного
+    const QPoint diagonal = pos - m_plotted;
+    if (qAbs(diagonal.x()) == 1 && qAbs(diagonal.y()) == 1) {
+        m_pending = pos;
+        m_pendingScale = scale;
+        return QRect();
+    }
+
+    const QRect dirty = plot(stroke, m_pending, 1, m_pendingScale);
+    m_pending = pos;
+    m_pendingScale = scale;
+    return dirty;
+}
+
+QRect PixelStroke::plot(StrokeBuffer& stroke, const QPoint& pos, int size, quint32 scale)
+{
+    m_plotted = pos;
+    const QVector<uchar>& mask = stamp(size);
+    const QRect rect(pos.x() - (size - 1) / 2, pos.y() - (size - 1) / 2, size, size);
+    return stroke.mergeMax(mask.constData(), size, rect, scale);
+}
+
+const QVector<uchar>& PixelStroke::stamp(int size)
+{
+    if (m_stamps.size() < size)
+        m_stamps.resize(size);
+
+    QVector<uchar>& mask = m_stamps[size - 1];
+    if (mask.isEmpty()) {
+        // Круг без сглаживания; радиус чуть уменьшен, чтобы штамп в 3 px был крестом, а не квадратом
+        mask.resize(size * size);
+        const qreal radius = size / 2.0 - 0.25;
+        const qreal center = size / 2.0;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const qreal dx = x + 0.5 - center;
+                const qreal dy = y + 0.5 - center;
+                mask[y * size + x] = dx * dx + dy * dy <= radius * radius ? 255 : 0;
+            }
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,37 @@
+#ifndef PIXELSTROKE_H
+#define PIXELSTROKE_H
+
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+#include "StrokeBuffer.h"
+
+// Быстрый путь карандаша для маленьких кистей без сглаживания: линия проходится
+// по Брезенхэму, в каждый пиксель ставится готовый круглый штамп.
+// В режиме "пиксель в пиксель" у кисти в 1 px убираются углы-ступеньки (буква L).
+class PixelStroke
+{
+public:
+    // Ставит первый пиксель штриха
+    QRect begin(StrokeBuffer& stroke, const QPoint& start, int size, quint32 scale, bool pixelPerfect);
+    // Ведет линию до end; scale - непрозрачность 0..256
+    QRect lineTo(StrokeBuffer& stroke, const QPoint& end, int size, quint32 scale);
+    // Ставит отложенный пиксель
+    QRect finish(StrokeBuffer& stroke);
+
+private:
+    QRect push(StrokeBuffer& stroke, const QPoint& pos, int size, quint32 scale);
+    QRect plot(StrokeBuffer& stroke, const QPoint& pos, int size, quint32 scale);
+    const QVector<uchar>& stamp(int size);
+
+    QPoint m_last;            // конец пройденной линии
+    bool m_pixelPerfect = false;
+    QPoint m_plotted;         // последний поставленный пиксель
+    bool m_hasPending = false;
+    QPoint m_pending;         // еще не поставленный пиксель: он может оказаться углом
+    quint32 m_pendingScale = 256;
+
+    QVector<QVector<uchar>> m_stamps;  // по размеру кисти
+};
+
+#endif // PIXELSTROKE_H
@@ -0,0 +1,269 @@
+#include "RegionLabelCache.h"
+#include "LayerManager.h"
+#include "FloodFill.h"
+#include <QSet>
+#include <algorithm>
+
+RegionLabelCache::RegionLabelCache(LayerManager* layers, QObject* parent)
+    : QObject(parent)
+    , m_layerManager(layers)
+{
+    m_pool.setMaxThreadCount(1);
+
+    if (m_layerManager) {
+        connect(m_layerManager, &LayerManager::layerPixelsChanged, this, &RegionLabelCache::onPixelsChanged);
+        connect(m_layerManager, &LayerManager::layerPropertyChanged, this, &RegionLabelCache::onPropertyChanged);
+        connect(m_layerManager, &LayerManager::layerInserted, this, &RegionLabelCache::onStructureChanged);
+        connect(m_layerManager, &LayerManager::layerRemoved, this, &RegionLabelCache::onStructureChanged);
+        connect(m_layerManager, &LayerManager::layerMoved, this, &RegionLabelCache::onStructureChanged);
+        connect(m_layerManager, &LayerManager::layersReset, this, &RegionLabelCache::onStructureChanged);
+    }
+}
+
+RegionLabelCache::~RegionLabelCache()
+{
+    // Результат фоновой задачи адресован this, поэтому ждем ее здесь
+    ++m_generation;
+    m_pool.waitForDone();
+}
+
+void RegionLabelCache::setSource(LayerId layerId)
+{
+    if (layerId == m_layerId && (m_ready || m_running))
+        return;
+
+    m_layerId = layerId;
+    restart();
+}
+
+QImage RegionLabelCache::sourceImage() const
+{
+    if (!m_layerManager || m_layerId < 0)
+        return QImage();
+    if (m_layerId == 0)
+        return m_layerManager->mergedImage();
+
+    const Layer* layer = m_layerManager->layerById(m_layerId);
+    return layer ? layer->image() : QImage();
+}
+
+void RegionLabelCache::restart()
+{
+    ++m_generation;
+    m_ready = false;
+    m_running = false;
+    m_labels = Labels();
+    m_dirty = QRegion();
+
+    // Снимок источника: дальнейшие правки слоя его не трогают и попадут в m_dirty
+    const QImage image = sourceImage();
+    if (image.isNull())
+        return;
+
+    m_running = true;
+    const int generation = m_generation;
+
+    m_pool.start([this, image, generation]() {
+        Labels labels;
+        labels.size = image.size();
+        labels.ids.fill(0, qsizetype(image.width()) * image.height());
+        labels.bounds.append(QRect());
+        labelArea(image, labels, image.rect());
+
+        QMetaObject::invokeMethod(this, [this, generation, labels]() {
+            if (generation != m_generation)
+                return;
+
+            m_labels = labels;
+            m_running = false;
+            m_ready = true;
+            emit labelsChanged();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void RegionLabelCache::labelArea(const QImage& image, Labels& labels, const QRect& area)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const uchar* bits = image.constBits();
+    const qsizetype bytesPerLine = image.bytesPerLine();
+    quint32* ids = labels.ids.data();
+
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            if (ids[qsizetype(y) * width + x])
+                continue;
+
+            const quint32 label = quint32(labels.bounds.size());
+            const QRgb target = reinterpret_cast<const QRgb*>(bits + y * bytesPerLine)[x];
+
+            auto open = [&](int px, int py) {
+                return ids[qsizetype(py) * width + px] == 0
+                    && reinterpret_cast<const QRgb*>(bits + py * bytesPerLine)[px] == target;
+            };
+            auto take = [&](int py, int x0, int x1) {
+                std::fill(ids + qsizetype(py) * width + x0, ids + qsizetype(py) * width + x1 + 1, label);
+            };
+            labels.bounds.append(FloodFill::growSpans(width, height, QPoint(x, y), open, take));
+        }
+    }
+}
+
+void RegionLabelCache::invalidate(const QRect& rect)
+{
+    if (!m_ready && !m_running)
+        return;
+
+    if (rect.isNull()) {
+        restart();
+        return;
+    }
+
+    m_dirty += rect;
+    if (m_dirty.rectCount() > 64)
+        m_dirty = m_dirty.boundingRect();
+}
+
+void RegionLabelCache::applyDirty()
+{
+    if (!m_ready || m_dirty.isEmpty())
+        return;
+
+    const QImage image = sourceImage();
+    if (image.size() != m_labels.size || image.format() != QImage::Format_ARGB32_Premultiplied) {
+        restart();
+        return;
+    }
+
+    // Соседние с правкой области тоже могли слиться с ней, поэтому +1 пиксель
+    const QRect area = m_dirty.boundingRect().adjusted(-1, -1, 1, 1) & image.rect();
+    m_dirty = QRegion();
+
+    const int width = image.width();
+    quint32* ids = m_labels.ids.data();
+
+    QSet<quint32> stale;
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        quint32 last = 0;
+        for (int x = area.left(); x <= area.right(); ++x) {
+            const quint32 id = ids[qsizetype(y) * width + x];
+            if (id != last) {
+                stale.insert(id);
+                last = id;
+            }
+        }
+    }
+    stale.remove(0);
+
+    // Задетые области сбрасываются целиком и размечаются заново
+    QRect affected = area;
+    for (quint32 id : stale)
+        affected |= m_labels.bounds[id];
+
+    // Правка рядом с большой областью (фоном, контуром через весь лист) задевает
+    // ее целиком; такое дешевле разметить заново в фоне, чем держать GUI-поток
+    if (qint64(affected.width()) * affected.height() * 4 > qint64(image.width()) * image.height()) {
+        restart();
+        return;
+    }
+
+    for (quint32 id : stale) {
+        const QRect bounds = m_labels.bounds[id];
+        for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+            quint32* row = ids + qsizetype(y) * width;
+            for (int x = bounds.left(); x <= bounds.right(); ++x) {
+                if (row[x] == id)
+                    row[x] = 0;
+            }
+        }
+        m_labels.bounds[id] = QRect();
+    }
+
+    labelArea(image, m_labels, affected);
+    emit labelsChanged();
+}
+
+quint32 RegionLabelCache::labelAt(const QPoint& pos)
+{
+    applyDirty();
+    if (!m_ready || !QRect(QPoint(0, 0), m_labels.size).contains(pos))
+        return 0;
+
+    return m_labels.ids[qsizetype(pos.y()) * m_labels.size.width() + pos.x()];
+}
+
+QRect RegionLabelCache::regionBounds(quint32 label) const
+{
+    if (!m_ready || label == 0 || label >= quint32(m_labels.bounds.size()))
+        return QRect();
+    return m_labels.bounds[label];
+}
+
+QRect RegionLabelCache::fillRegion(QImage& image, quint32 label, QRgb pixel, const QRect& clip) const
+{
+    const QRect bounds = regionBounds(label) & clip;
+    if (bounds.isEmpty() || image.size() != m_labels.size)
+        return QRect();
+
+    const int width = m_labels.size.width();
+    for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        const quint32* row = m_labels.ids.constData() + qsizetype(y) * width;
+        for (int x = bounds.left(); x <= bounds.right(); ++x) {
+            if (row[x] == label)
+                line[x] = pixel;
+        }
+    }
+    return bounds;
+}
+
+QImage RegionLabelCache::regionOverlay(quint32 label, QRgb pixel, const QRect& area) const
+{
+    const QRect bounds = regionBounds(label) & area;
+    if (bounds.isEmpty())
+        return QImage();
+
+    QImage overlay(bounds.size(), QImage::Format_ARGB32_Premultiplied);
+    overlay.fill(Qt::transparent);
+
+    const int width = m_labels.size.width();
+    for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(overlay.scanLine(y - bounds.top()));
+        const quint32* row = m_labels.ids.constData() + qsizetype(y) * width;
+        for (int x = bounds.left(); x <= bounds.right(); ++x) {
+            if (row[x] == label)
+                line[x - bounds.left()] = pixel;
+        }
+    }
+    return overlay;
+}
+
+void RegionLabelCache::onPixelsChanged(int index, const QRect& rect)
+{
+    const Layer* layer = m_layerManager->layerAt(index);
+    if (!layer)
+        return;
+
+    // Для композита важны только видимые слои
+    if (m_layerId == 0) {
+        if (layer->isVisible() && layer->opacity() > 0.0f)
+            invalidate(rect);
+    } else if (layer->id() == m_layerId) {
+        invalidate(rect);
+    }
+}
+
+void RegionLabelCache::onPropertyChanged(int index, LayerProperty property)
+{
+    Q_UNUSED(index)
+    if (m_layerId == 0 && property != LayerProperty::Name)
+        invalidate(QRect());
+}
+
+void RegionLabelCache::onStructureChanged()
+{
+    // Слой по id переживает перемещения; композит меняется при любой перестановке
+    if (m_layerId == 0 || (m_layerId > 0 && m_layerManager->indexOf(m_layerId) < 0))
+        invalidate(QRect());
+}
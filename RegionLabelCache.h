@@ -0,0 +1,77 @@
+#ifndef REGIONLABELCACHE_H
+#define REGIONLABELCACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QRegion>
+#include <QThreadPool>
+#include <QVector>
+#include "Layer.h"
+
+class LayerManager;
+
+// Разметка изображения на связные области одного цвета для заливки без допуска.
+// Первая разметка строится в фоне, дальше правки слоя переразмечают только
+// задетые области. Точное совпадение цвета - отношение эквивалентности, поэтому
+// область не зависит от того, из какого ее пикселя начата заливка. С допуском
+// это не так, и такие заливки идут через FloodFill от точки щелчка.
+class RegionLabelCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RegionLabelCache(LayerManager* layers, QObject* parent = nullptr);
+    ~RegionLabelCache() override;
+
+    // Что размечать: слой по id или композит всех слоев (0).
+    // При смене источника старая разметка выбрасывается и запускается новая
+    void setSource(LayerId layerId);
+
+    bool isReady() const { return m_ready; }
+
+    // Номер области под точкой, 0 - разметка еще не готова
+    quint32 labelAt(const QPoint& pos);
+    QRect regionBounds(quint32 label) const;
+
+    // Записывает pixel во все пиксели области внутри clip; возвращает измененный прямоугольник
+    QRect fillRegion(QImage& image, quint32 label, QRgb pixel, const QRect& clip) const;
+    // Маска области в пределах area (ее положение - regionBounds(label) & area)
+    QImage regionOverlay(quint32 label, QRgb pixel, const QRect& area) const;
+
+signals:
+    // Разметка построена или перестроена, прежние номера недействительны
+    void labelsChanged();
+
+private slots:
+    void onPixelsChanged(int index, const QRect& rect);
+    void onPropertyChanged(int index, LayerProperty property);
+    void onStructureChanged();
+
+private:
+    struct Labels
+    {
+        QSize size;
+        QVector<quint32> ids;      // номер области для каждого пикселя
+        QVector<QRect> bounds;     // границы области по номеру; [0] не используется
+    };
+
+    QImage sourceImage() const;
+    void restart();
+    void invalidate(const QRect& rect);
+    void applyDirty();
+
+    static void labelArea(const QImage& image, Labels& labels, const QRect& area);
+
+    LayerManager* m_layerManager;
+    LayerId m_layerId = -1;
+
+    Labels m_labels;
+    bool m_ready = false;
+    bool m_running = false;
+    int m_generation = 0;
+    QRegion m_dirty;
+
+    // Свой пул: деструктор дожидается фоновой разметки до разрушения объекта
+    QThreadPool m_pool;
+};
+
+#endif // REGIONLABELCACHE_H
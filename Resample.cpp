@@ -0,0 +1,226 @@
+#include "Resample.h"
+#include "Parallel.h"
+#include "PixelOps.h"
+#include "Config.h"
+#include <QtMath>
+#include <QVector>
+#include <algorithm>
+
+namespace Resample
+{
+
+namespace
+{
+    // Пиксель source или прозрачный за его краем
+    inline quint32 fetch(const uchar* bits, qsizetype bytesPerLine, int width, int height, int x, int y)
+    {
+        if (x < 0 || y < 0 || x >= width || y >= height)
+            return 0;
+        return reinterpret_cast<const QRgb*>(bits + y * bytesPerLine)[x];
+    }
+
+    // Таблица весов одного прохода: для каждого выходного пикселя taps
+    // индексов исходных пикселей и веса в 1/16384 с суммой ровно 16384
+    struct WeightTable
+    {
+        int taps = 0;
+        QVector<int> index;
+        QVector<int> weight;
+    };
+
+    double lanczos3(double x)
+    {
+        x = qAbs(x);
+        if (x < 1e-8)
+            return 1.0;
+        if (x >= 3.0)
+            return 0.0;
+        const double px = M_PI * x;
+        return 3.0 * qSin(px) * qSin(px / 3.0) / (px * px);
+    }
+
+    WeightTable lanczosWeights(int sourceSize, int targetSize)
+    {
+        const double scale = double(targetSize) / sourceSize;
+        const double stretch = qMax(1.0, 1.0 / scale);
+        const double support = 3.0 * stretch;
+
+        WeightTable table;
+        table.taps = 2 * qCeil(support) + 1;
+        table.index.resize(targetSize * table.taps);
+        table.weight.resize(targetSize * table.taps);
+
+        QVector<double> raw(table.taps);
+        for (int i = 0; i < targetSize; ++i) {
+            const double center = (i + 0.5) / scale - 0.5;
+            const int first = qFloor(center) - table.taps / 2;
+            double total = 0.0;
+            for (int k = 0; k < table.taps; ++k) {
+                raw[k] = lanczos3((first + k - center) / stretch);
+                total += raw[k];
+            }
+
+            // За краем повторяется крайний пиксель; остаток округления - к самому весомому отсчету
+            int sum = 0;
+            int heaviest = 0;
+            for (int k = 0; k < table.taps; ++k) {
+                const int w = qRound(raw[k] / total * 16384.0);
+                table.index[i * table.taps + k] = qBound(0, first + k, sourceSize - 1);
+                table.weight[i * table.taps + k] = w;
+                sum += w;
+                if (raw[k] > raw[heaviest])
+                    heaviest = k;
+            }
+            table.weight[i * table.taps + heaviest] += 16384 - sum;
+        }
+        return table;
+    }
+
+    inline uchar clampByte(int value)
+    {
+        return uchar(qBound(0, (value + 8192) >> 14, 255));
+    }
+}
+
+QRect drawTransformed(QImage& target, const QImage& source, const QTransform& transform, const QRect& clip)
+{
+    if (source.isNull() || !transform.isAffine() || !transform.isInvertible()
+        || target.format() != QImage::Format_ARGB32_Premultiplied
+        || source.format() != QImage::Format_ARGB32_Premultiplied)
+        return QRect();
+
+    const QRect area = transform.mapRect(QRectF(source.rect())).toAlignedRect() & clip & target.rect();
+    if (area.isEmpty())
+        return QRect();
+
+    // Для каждого пикселя результата ищется точка в source: шаг по x и y постоянный
+    const QTransform inverse = transform.inverted();
+    const qreal du = inverse.m11();
+    const qreal dv = inverse.m12();
+
+    // Отделение данных до запуска потоков
+    uchar* dstBits = target.bits();
+    const qsizetype dstStride = target.bytesPerLine();
+    const uchar* srcBits = source.constBits();
+    const qsizetype srcStride = source.bytesPerLine();
+    const int srcWidth = source.width();
+    const int srcHeight = source.height();
+
+    const int tile = IMAGE_TILE_SIZE;
+    const int bands = (area.height() + tile - 1) / tile;
+    Parallel::forRanges(bands, 1, [&](int firstBand, int endBand) {
+        const int y0 = area.top() + firstBand * tile;
+        const int y1 = qMin(area.bottom() + 1, area.top() + endBand * tile);
+        for (int y = y0; y < y1; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(dstBits + y * dstStride);
+            // Центр пикселя результата в координатах source, сдвинутый к центрам пикселей
+            const QPointF start = inverse.map(QPointF(area.left() + 0.5, y + 0.5));
+            qreal u = start.x() - 0.5;
+            qreal v = start.y() - 0.5;
+
+            for (int x = area.left(); x <= area.right(); ++x, u += du, v += dv) {
+                if (u <= -1.0 || v <= -1.0 || u >= srcWidth || v >= srcHeight)
+                    continue;
+
+                const int sx = qFloor(u);
+                const int sy = qFloor(v);
+                const quint32 fx = quint32((u - sx) * 256);
+                const quint32 fy = quint32((v - sy) * 256);
+
+                const quint32 tl = fetch(srcBits, srcStride, srcWidth, srcHeight, sx, sy);
+                const quint32 tr = fetch(srcBits, srcStride, srcWidth, srcHeight, sx + 1, sy);
+                const quint32 bl = fetch(srcBits, srcStride, srcWidth, srcHeight, sx, sy + 1);
+                const quint32 br = fetch(srcBits, srcStride, srcWidth, srcHeight, sx + 1, sy + 1);
+
+                const quint32 top = PixelOps::interpolate256(tl, 256 - fx, tr, fx);
+                const quint32 bottom = PixelOps::interpolate256(bl, 256 - fx, br, fx);
+                const quint32 pixel = PixelOps::interpolate256(top, 256 - fy, bottom, fy);
+                if (pixel)
+                    line[x] = PixelOps::sourceOver(line[x], pixel);
+            }
+        }
+    });
+
+    return area;
+}
+
+QImage lanczos(const QImage& source, const QSize& size)
+{
+    if (source.isNull() || size.isEmpty())
+        return QImage();
+    if (size == source.size())
+        return source;
+
+    const QImage input = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const WeightTable columns = lanczosWeights(input.width(), size.width());
+    const WeightTable rows = lanczosWeights(input.height(), size.height());
+
+    // Сначала по горизонтали: ширина уже новая, высота исходная
+    QImage wide(size.width(), input.height(), QImage::Format_ARGB32_Premultiplied);
+    {
+        const uchar* srcBits = input.constBits();
+        const qsizetype srcStride = input.bytesPerLine();
+        uchar* dstBits = wide.bits();
+        const qsizetype dstStride = wide.bytesPerLine();
+
+        Parallel::forRanges(input.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                const uchar* src = srcBits + y * srcStride;
+                uchar* dst = dstBits + y * dstStride;
+                for (int x = 0; x < size.width(); ++x) {
+                    const int* index = columns.index.constData() + x * columns.taps;
+                    const int* weight = columns.weight.constData() + x * columns.taps;
+                    int acc[4] = { 0, 0, 0, 0 };
+                    for (int k = 0; k < columns.taps; ++k) {
+                        const uchar* pixel = src + index[k] * 4;
+                        for (int c = 0; c < 4; ++c)
+                            acc[c] += pixel[c] * weight[k];
+                    }
+                    for (int c = 0; c < 4; ++c)
+                        dst[x * 4 + c] = clampByte(acc[c]);
+                }
+            }
+        });
+    }
+
+    // Затем по вертикали: строки-источники общие для всей выходной строки,
+    // поэтому внутренний цикл идет по сплошному массиву каналов
+    QImage result(size, QImage::Format_ARGB32_Premultiplied);
+    {
+        const uchar* srcBits = wide.constBits();
+        const qsizetype srcStride = wide.bytesPerLine();
+        uchar* dstBits = result.bits();
+        const qsizetype dstStride = result.bytesPerLine();
+        const int count = size.width() * 4;
+
+        Parallel::forRanges(size.height(), IMAGE_TILE_SIZE, [&](int begin, int end) {
+            QVector<int> acc(count);
+            for (int y = begin; y < end; ++y) {
+                std::fill(acc.begin(), acc.end(), 0);
+                for (int k = 0; k < rows.taps; ++k) {
+                    const int w = rows.weight[y * rows.taps + k];
+                    if (w == 0)
+                        continue;
+                    const uchar* src = srcBits + rows.index[y * rows.taps + k] * srcStride;
+                    int* sum = acc.data();
+                    for (int i = 0; i < count; ++i)
+                        sum[i] += src[i] * w;
+                }
+
+                // Отрицательные лепестки могут вывести цвет за альфу - возвращаем в premultiplied
+                QRgb* dst = reinterpret_cast<QRgb*>(dstBits + y * dstStride);
+                for (int x = 0; x < size.width(); ++x) {
+                    uchar* pixel = reinterpret_cast<uchar*>(dst + x);
+                    for (int c = 0; c < 4; ++c)
+                        pixel[c] = clampByte(acc[x * 4 + c]);
+                    const int alpha = qAlpha(dst[x]);
+                    dst[x] = qRgba(qMin(qRed(dst[x]), alpha), qMin(qGreen(dst[x]), alpha),
+                                   qMin(qBlue(dst[x]), alpha), alpha);
+                }
+            }
+        });
+    }
+    return result;
+}
+
+}
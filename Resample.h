@@ -0,0 +1,22 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <QImage>
+#include <QTransform>
+#include <QRect>
+
+// Пересчет изображений с фильтрацией. Все функции работают с
+// Format_ARGB32_Premultiplied и делят результат на полосы плиток для пула потоков.
+namespace Resample
+{
+    // Накладывает source поверх target (source-over) с аффинным преобразованием
+    // transform (координаты source -> координаты target) и билинейной фильтрацией.
+    // Пишется только внутри clip; возвращает измененный прямоугольник.
+    QRect drawTransformed(QImage& target, const QImage& source, const QTransform& transform, const QRect& clip);
+
+    // Новое изображение размера size, пересчитанное раздельным фильтром Ланцоша (a = 3).
+    // При уменьшении ядро растягивается, чтобы усреднять все покрытые пиксели
+    QImage lanczos(const QImage& source, const QSize& size);
+}
+
+#endif // RESAMPLE_H
@@ -0,0 +1,246 @@
+#include "Selection.h"
+#include <QPainter>
+#include <QByteArray>
+#include <cstring>
+
+Selection Selection::fromRect(const QRect& rect, const QSize& canvas)
+{
+    const QRect bounds = rect.normalized() & QRect(QPoint(0, 0), canvas);
+    if (bounds.isEmpty())
+        return Selection();
+
+    QImage mask(bounds.size(), QImage::Format_Alpha8);
+    mask.fill(255);
+    return fromMask(mask, bounds.topLeft());
+}
+
+Selection Selection::fromEllipse(const QRect& rect, const QSize& canvas)
+{
+    QPainterPath path;
+    path.addEllipse(QRectF(rect.normalized()));
+    return fromShape(path, canvas);
+}
+
+Selection Selection::fromPolygon(const QPolygonF& polygon, const QSize& canvas)
+{
+    if (polygon.size() < 3)
+        return Selection();
+
+    QPainterPath path;
+    path.addPolygon(polygon);
+    path.closeSubpath();
+    return fromShape(path, canvas);
+}
+
+Selection Selection::fromShape(const QPainterPath& path, const QSize& canvas)
+{
+    const QRect bounds = path.boundingRect().toAlignedRect() & QRect(QPoint(0, 0), canvas);
+    if (bounds.isEmpty())
+        return Selection();
+
+    // Маска рисуется только в пределах фигуры, а не всего холста
+    QImage mask(bounds.size(), QImage::Format_Alpha8);
+    mask.fill(0);
+    {
+        QPainter painter(&mask);
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        painter.translate(-bounds.topLeft());
+        painter.fillPath(path, Qt::white);
+    }
+    return fromMask(mask, bounds.topLeft());
+}
+
+Selection Selection::fromMask(const QImage& mask, const QPoint& offset)
+{
+    Q_ASSERT(mask.isNull() || mask.format() == QImage::Format_Alpha8);
+
+    // Границы подрезаются по ненулевому покрытию
+    int left = mask.width(), right = -1, top = mask.height(), bottom = -1;
+    for (int y = 0; y < mask.height(); ++y) {
+        const uchar* row = mask.constScanLine(y);
+        int first = 0;
+        while (first < mask.width() && row[first] == 0)
+            ++first;
+        if (first == mask.width())
+            continue;
+        int last = mask.width() - 1;
+        while (row[last] == 0)
+            --last;
+
+        left = qMin(left, first);
+        right = qMax(right, last);
+        top = qMin(top, y);
+        bottom = qMax(bottom, y);
+    }
+
+    Selection selection;
+    if (right < 0)
+        return selection;
+
+    const QRect tight(QPoint(left, top), QPoint(right, bottom));
+    selection.m_mask = tight == mask.rect() ? mask : mask.copy(tight);
+    selection.m_bounds = tight.translated(offset);
+    selection.buildOutline();
+    return selection;
+}
+
+// Частичное покрытие: premultiplied-смешение старого и нового
+static QRgb blendCoverage(QRgb from, QRgb to, int c)
+{
+    auto mix = [c](int a, int b) { return a + ((b - a) * c + (b >= a ? 127 : -127)) / 255; };
+    return qRgba(mix(qRed(from), qRed(to)),
+                 mix(qGreen(from), qGreen(to)),
+                 mix(qBlue(from), qBlue(to)),
+                 mix(qAlpha(from), qAlpha(to)));
+}
+
+int Selection::coverage(int x, int y) const
+{
+    if (!m_bounds.contains(x, y))
+        return 0;
+    return m_mask.constScanLine(y - m_bounds.top())[x - m_bounds.left()];
+}
+
+Selection Selection::combined(const Selection& other, SelectionOp op) const
+{
+    switch (op) {
+    case SelectionOp::Replace:
+        return other;
+    case SelectionOp::Add:
+        if (isEmpty())
+            return other;
+        if (other.isEmpty())
+            return *this;
+        break;
+    case SelectionOp::Subtract:
+        if (isEmpty() || other.isEmpty() || !m_bounds.intersects(other.m_bounds))
+            return *this;
+        break;
+    }
+
+    // Сложение расширяет границы, вычитание не выходит за текущие
+    const QRect bounds = op == SelectionOp::Add ? (m_bounds | other.m_bounds) : m_bounds;
+    QImage mask(bounds.size(), QImage::Format_Alpha8);
+    mask.fill(0);
+
+    for (int y = 0; y < bounds.height(); ++y) {
+        const int canvasY = bounds.top() + y;
+        uchar* row = mask.scanLine(y);
+        if (canvasY >= m_bounds.top() && canvasY <= m_bounds.bottom()) {
+            std::memcpy(row + (m_bounds.left() - bounds.left()),
+                        m_mask.constScanLine(canvasY - m_bounds.top()), m_bounds.width());
+        }
+
+        if (canvasY < other.m_bounds.top() || canvasY > other.m_bounds.bottom())
+            continue;
+
+        const uchar* src = other.m_mask.constScanLine(canvasY - other.m_bounds.top());
+        const int x0 = qMax(bounds.left(), other.m_bounds.left());
+        const int x1 = qMin(bounds.right(), other.m_bounds.right());
+        for (int x = x0; x <= x1; ++x) {
+            uchar& dst = row[x - bounds.left()];
+            const int cover = src[x - other.m_bounds.left()];
+            if (op == SelectionOp::Add)
+                dst = uchar(qMax(int(dst), cover));
+            else
+                dst = uchar((dst * (255 - cover) + 127) / 255);
+        }
+    }
+
+    return fromMask(mask, bounds.topLeft());
+}
+
+void Selection::buildOutline()
+{
+    // Граница между пикселями внутри (покрытие >= 128) и снаружи.
+    // Строки сравниваются попарно: одинаковые соседние строки горизонтальных
+    // границ не дают, поэтому сплошная область обходится почти даром.
+    m_outline = QPainterPath();
+    const int width = m_mask.width();
+    const int height = m_mask.height();
+
+    QByteArray above(width, 0);
+    QByteArray current(width, 0);
+    for (int y = 0; y <= height; ++y) {
+        if (y < height) {
+            const uchar* row = m_mask.constScanLine(y);
+            char* flags = current.data();
+            for (int x = 0; x < width; ++x)
+                flags[x] = row[x] >= 128;
+        } else {
+            current.fill(0);
+        }
+
+        if (above != current) {
+            int runStart = -1;
+            for (int x = 0; x <= width; ++x) {
+                const bool edge = x < width && above[x] != current[x];
+                if (edge && runStart < 0) {
+                    runStart = x;
+                } else if (!edge && runStart >= 0) {
+                    m_outline.moveTo(runStart, y);
+                    m_outline.lineTo(x, y);
+                    runStart = -1;
+                }
+            }
+        }
+
+        if (y < height) {
+            char previous = 0;
+            for (int x = 0; x <= width; ++x) {
+                const char inside = x < width ? current[x] : 0;
+                if (inside != previous) {
+                    m_outline.moveTo(x, y);
+                    m_outline.lineTo(x, y + 1);
+                }
+                previous = inside;
+            }
+        }
+        std::swap(above, current);
+    }
+
+    m_outline.translate(m_bounds.topLeft());
+}
+
+void Selection::applyMask(QImage& image, const QImage& before, const QPoint& beforeOffset, const QRect& rect) const
+{
+    if (isEmpty())
+        return;
+
+    const QRect area = rect & image.rect() & QRect(beforeOffset, before.size());
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        const QRgb* old = reinterpret_cast<const QRgb*>(before.constScanLine(y - beforeOffset.y()));
+        const bool rowInside = y >= m_bounds.top() && y <= m_bounds.bottom();
+        const uchar* cover = rowInside ? m_mask.constScanLine(y - m_bounds.top()) : nullptr;
+
+        for (int x = area.left(); x <= area.right(); ++x) {
+            const QRgb from = old[x - beforeOffset.x()];
+            const int c = (cover && x >= m_bounds.left() && x <= m_bounds.right()) ? cover[x - m_bounds.left()] : 0;
+            if (c == 255 || line[x] == from)
+                continue;
+            if (c == 0) {
+                line[x] = from;
+                continue;
+            }
+
+            line[x] = blendCoverage(from, line[x], c);
+        }
+    }
+}
+
+void Selection::applyMask(QImage& patch, const QImage& before, const QPoint& offset) const
+{
+    if (isEmpty())
+        return;
+
+    for (int y = 0; y < patch.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(patch.scanLine(y));
+        const QRgb* old = reinterpret_cast<const QRgb*>(before.constScanLine(y));
+        for (int x = 0; x < patch.width(); ++x) {
+            const int c = coverage(offset.x() + x, offset.y() + y);
+            if (c != 255 && line[x] != old[x])
+                line[x] = blendCoverage(old[x], line[x], c);
+        }
+    }
+}
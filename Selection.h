@@ -0,0 +1,56 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <QImage>
+#include <QRect>
+#include <QPolygonF>
+#include <QPainterPath>
+
+// Как новое выделение сочетается с текущим
+enum class SelectionOp {
+    Replace,
+    Add,
+    Subtract
+};
+
+// Выделение: 8-битная маска покрытия только в пределах своих границ.
+// Пустое выделение означает "весь слой доступен".
+class Selection
+{
+public:
+    Selection() = default;
+
+    static Selection fromRect(const QRect& rect, const QSize& canvas);
+    static Selection fromEllipse(const QRect& rect, const QSize& canvas);
+    static Selection fromPolygon(const QPolygonF& polygon, const QSize& canvas);
+    // mask - Format_Alpha8, offset - положение ее левого верхнего угла на холсте
+    static Selection fromMask(const QImage& mask, const QPoint& offset);
+
+    bool isEmpty() const { return m_bounds.isEmpty(); }
+    QRect bounds() const { return m_bounds; }
+    const QImage& mask() const { return m_mask; }
+
+    // Покрытие 0..255 в координатах холста
+    int coverage(int x, int y) const;
+
+    Selection combined(const Selection& other, SelectionOp op) const;
+
+    // Контур для "бегущих муравьев"; строится один раз при создании выделения
+    const QPainterPath& outline() const { return m_outline; }
+
+    // Внутри rect оставляет изменения image только под маской, остальное
+    // возвращает из before (before лежит на холсте со смещением beforeOffset)
+    void applyMask(QImage& image, const QImage& before, const QPoint& beforeOffset, const QRect& rect) const;
+    // То же для участка холста: patch и before одного размера и лежат в offset
+    void applyMask(QImage& patch, const QImage& before, const QPoint& offset) const;
+
+private:
+    static Selection fromShape(const QPainterPath& path, const QSize& canvas);
+    void buildOutline();
+
+    QRect m_bounds;
+    QImage m_mask;
+    QPainterPath m_outline;
+};
+
+#endif // SELECTION_H
@@ -0,0 +1,136 @@
+#include "StrokeBuffer.h"
+#include "LayerManager.h"
+#include "Selection.h"
+#include "Config.h"
+#include "PixelOps.h"
+#include <QPainter>
+#include <QtMath>
+
+namespace
+{
+    int tileIndex(int coordinate)
+    {
+        return coordinate >= 0 ? coordinate / IMAGE_TILE_SIZE : -((-coordinate - 1) / IMAGE_TILE_SIZE) - 1;
+    }
+}
+
+bool StrokeBuffer::begin(LayerManager* layers, const QColor& color, Mode mode)
+{
+    clear();
+
+    const Layer* layer = layers ? layers->layerAt(layers->activeLayerIndex()) : nullptr;
+    if (!layer)
+        return false;
+
+    m_layerId = layer->id();
+    m_color = qPremultiply(color.rgba());
+    m_mode = mode;
+    // Штрих не выходит за слой и за границы выделения
+    const Selection& selection = layers->selection();
+    m_clip = selection.isEmpty() ? layer->image().rect() : selection.bounds() & layer->image().rect();
+    return true;
+}
+
+void StrokeBuffer::clear()
+{
+    m_layerId = 0;
+    m_bounds = QRect();
+    m_tiles.clear();
+    m_cachedTile = nullptr;
+}
+
+uchar* StrokeBuffer::tileLine(const QPoint& tile, int y)
+{
+    // Мелкие штампы подряд попадают в одну плитку: поиск в хэше пропускается
+    if (!m_cachedTile || m_cachedKey != tile) {
+        auto it = m_tiles.find(tile);
+        if (it == m_tiles.end()) {
+            QImage image(IMAGE_TILE_SIZE, IMAGE_TILE_SIZE, QImage::Format_Alpha8);
+            image.fill(0);
+            it = m_tiles.insert(tile, image);
+        }
+        m_cachedKey = tile;
+        m_cachedTile = it->bits();
+        m_cachedStride = it->bytesPerLine();
+    }
+    return m_cachedTile + (y - tile.y() * IMAGE_TILE_SIZE) * m_cachedStride;
+}
+
+QRect StrokeBuffer::mergeMax(const uchar* coverage, qsizetype stride, const QRect& rect, quint32 scale)
+{
+    const QRect area = rect & m_clip;
+    if (!isActive() || area.isEmpty())
+        return QRect();
+
+    for (int ty = tileIndex(area.top()); ty <= tileIndex(area.bottom()); ++ty) {
+        for (int tx = tileIndex(area.left()); tx <= tileIndex(area.right()); ++tx) {
+            const QRect tileRect(tx * IMAGE_TILE_SIZE, ty * IMAGE_TILE_SIZE, IMAGE_TILE_SIZE, IMAGE_TILE_SIZE);
+            const QRect part = area & tileRect;
+            for (int y = part.top(); y <= part.bottom(); ++y) {
+                const uchar* src = coverage + (y - rect.top()) * stride + (part.left() - rect.left());
+                uchar* dst = tileLine(QPoint(tx, ty), y) + (part.left() - tileRect.left());
+                for (int x = 0; x < part.width(); ++x) {
+                    const uchar value = uchar((src[x] * scale) >> 8);
+                    if (value > dst[x])
+                        dst[x] = value;
+                }
+            }
+        }
+    }
+
+    m_bounds |= area;
+    return area;
+}
+
+QRect StrokeBuffer::paint(const QRect& rect, const std::function<void(QPainter&)>& draw)
+{
+    const QRect area = rect & m_clip;
+    if (!isActive() || area.isEmpty())
+        return QRect();
+
+    QImage scratch(area.size(), QImage::Format_Alpha8);
+    scratch.fill(0);
+    {
+        QPainter painter(&scratch);
+        painter.translate(-area.topLeft());
+        draw(painter);
+    }
+    return mergeMax(scratch.constBits(), scratch.bytesPerLine(), area);
+}
+
+void StrokeBuffer::composite(QImage& image, const QPoint& offset, const QRect& rect, const Selection* selection) const
+{
+    const QRect area = rect & m_bounds & QRect(offset, image.size());
+    if (area.isEmpty() || image.format() != QImage::Format_ARGB32_Premultiplied)
+        return;
+    if (selection && selection->isEmpty())
+        selection = nullptr;
+
+    for (int ty = tileIndex(area.top()); ty <= tileIndex(area.bottom()); ++ty) {
+        for (int tx = tileIndex(area.left()); tx <= tileIndex(area.right()); ++tx) {
+            auto it = m_tiles.constFind(QPoint(tx, ty));
+            if (it == m_tiles.constEnd())
+                continue;
+
+            const QRect tileRect(tx * IMAGE_TILE_SIZE, ty * IMAGE_TILE_SIZE, IMAGE_TILE_SIZE, IMAGE_TILE_SIZE);
+            const QRect part = area & tileRect;
+            for (int y = part.top(); y <= part.bottom(); ++y) {
+                const uchar* cover = it->constScanLine(y - tileRect.top());
+                QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y - offset.y()));
+                for (int x = part.left(); x <= part.right(); ++x) {
+                    quint32 c = cover[x - tileRect.left()];
+                    if (c && selection)
+                        c = (c * selection->coverage(x, y) + 127) / 255;
+                    if (c == 0)
+                        continue;
+
+                    QRgb& pixel = line[x - offset.x()];
+                    if (m_mode == Mode::Erase)
+                        pixel = PixelOps::byteMul(pixel, 255 - c);
+                    else
+                        pixel = PixelOps::sourceOver(pixel, PixelOps::byteMul(m_color, c));
+                }
+            }
+        }
+    }
+}
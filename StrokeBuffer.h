@@ -0,0 +1,62 @@
+#ifndef STROKEBUFFER_H
+#define STROKEBUFFER_H
+
+#include <QImage>
+#include <QHash>
+#include <QColor>
+#include <QPoint>
+#include <QRect>
+#include <functional>
+#include "Layer.h"
+
+class QPainter;
+class LayerManager;
+class Selection;
+
+// Черновик одного штриха: покрытие 0..255 плитками только там, где штрих прошел.
+// Отпечатки сливаются по максимуму, поэтому перекрытия внутри штриха не копят
+// непрозрачность. Пока штрих идет, слой не меняется: LayerView накладывает
+// черновик поверх него, а в слой штрих сливается один раз при отпускании.
+class StrokeBuffer
+{
+public:
+    enum class Mode {
+        Paint,  // цветом поверх слоя
+        Erase   // стирание альфы слоя
+    };
+
+    // Начинает штрих по активному слою; false, если слоя нет
+    bool begin(LayerManager* layers, const QColor& color, Mode mode);
+    void clear();
+
+    bool isActive() const { return m_layerId != 0; }
+    LayerId layerId() const { return m_layerId; }
+    // Границы всего, что штрих успел покрыть
+    QRect bounds() const { return m_bounds; }
+
+    // Сливает по максимуму маску rect (stride байт на строку), умноженную на scale/256.
+    // Возвращает часть rect, попавшую в допустимую область.
+    QRect mergeMax(const uchar* coverage, qsizetype stride, const QRect& rect, quint32 scale = 256);
+    // Рисует draw во временную маску rect и сливает ее по максимуму
+    QRect paint(const QRect& rect, const std::function<void(QPainter&)>& draw);
+
+    // Накладывает штрих на участок rect изображения image, лежащего на холсте со смещением offset.
+    // selection (если задано) ослабляет штрих по покрытию выделения.
+    void composite(QImage& image, const QPoint& offset, const QRect& rect,
+                   const Selection* selection = nullptr) const;
+
+private:
+    uchar* tileLine(const QPoint& tile, int y);
+
+    LayerId m_layerId = 0;
+    QRgb m_color = 0;
+    Mode m_mode = Mode::Paint;
+    QRect m_clip;
+    QRect m_bounds;
+    QHash<QPoint, QImage> m_tiles;  // ключ - номер плитки IMAGE_TILE_SIZE
+    QPoint m_cachedKey;
+    uchar* m_cachedTile = nullptr;  // данные плитки не переезжают при росте хэша
+    qsizetype m_cachedStride = 0;
+};
+
+#endif // STROKEBUFFER_H
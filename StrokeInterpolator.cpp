@@ -0,0 +1,119 @@
+#include "StrokeInterpolator.h"
+#include <QLineF>
+#include <QtMath>
+#include "Config.h"
+
+static qreal distance(const QPointF& a, const QPointF& b)
+{
+    return QLineF(a, b).length();
+}
+
+// Отражение соседнего узла: так задаются недостающие крайние узлы
+static StrokeSample mirrored(const StrokeSample& pivot, const StrokeSample& other)
+{
+    StrokeSample sample = pivot;
+    sample.pos = pivot.pos * 2.0 - other.pos;
+    return sample;
+}
+
+void StrokeInterpolator::reset(const StrokeSample& first)
+{
+    m_knots.clear();
+    m_knots.append(first);
+    m_finished = false;
+}
+
+bool StrokeInterpolator::addKnot(const StrokeSample& sample)
+{
+    // Совпадающие узлы вырождают параметризацию
+    if (!m_knots.isEmpty() && distance(m_knots.last().pos, sample.pos) < STROKE_MIN_SAMPLE_DISTANCE) {
+        m_knots.last().pressure = sample.pressure;
+        m_knots.last().timestamp = sample.timestamp;
+        return false;
+    }
+
+    m_knots.append(sample);
+    if (m_knots.size() > 4)
+        m_knots.removeFirst();
+    return true;
+}
+
+QVector<StrokeSample> StrokeInterpolator::addSamples(const QVector<StrokeSample>& samples)
+{
+    QVector<StrokeSample> out;
+    if (m_finished)
+        return out;
+
+    for (const StrokeSample& sample : samples) {
+        if (!addKnot(sample))
+            continue;
+
+        // Узлов p0..p3 достаточно для отрезка p1 -> p2
+        if (m_knots.size() == 3)
+            emitSegment(mirrored(m_knots[0], m_knots[1]), m_knots[0], m_knots[1], m_knots[2], out);
+        else if (m_knots.size() == 4)
+            emitSegment(m_knots[0], m_knots[1], m_knots[2], m_knots[3], out);
+    }
+    return out;
+}
+
+QVector<StrokeSample> StrokeInterpolator::finish(const StrokeSample& last)
+{
+    QVector<StrokeSample> out = addSamples({ last });
+    if (m_finished)
+        return out;
+    m_finished = true;
+
+    const int n = m_knots.size();
+    if (n < 2)
+        return out;
+
+    // Последний отрезок еще не нарисован: продолжаем кривую отражением
+    const StrokeSample& p1 = m_knots[n - 2];
+    const StrokeSample& p2 = m_knots[n - 1];
+    const StrokeSample p0 = n >= 3 ? m_knots[n - 3] : mirrored(p1, p2);
+    emitSegment(p0, p1, p2, mirrored(p2, p1), out);
+    return out;
+}
+
+void StrokeInterpolator::emitSegment(const StrokeSample& p0, const StrokeSample& p1,
+                                     const StrokeSample& p2, const StrokeSample& p3,
+                                     QVector<StrokeSample>& out) const
+{
+    // Центростремительная параметризация: шаг узла равен корню из длины хорды
+    const qreal minStep = 1e-4;
+    const qreal t0 = 0.0;
+    const qreal t1 = t0 + qMax(minStep, qSqrt(distance(p0.pos, p1.pos)));
+    const qreal t2 = t1 + qMax(minStep, qSqrt(distance(p1.pos, p2.pos)));
+    const qreal t3 = t2 + qMax(minStep, qSqrt(distance(p2.pos, p3.pos)));
+
+    auto evaluate = [&](qreal t) {
+        const QPointF a1 = (p0.pos * (t1 - t) + p1.pos * (t - t0)) / (t1 - t0);
+        const QPointF a2 = (p1.pos * (t2 - t) + p2.pos * (t - t1)) / (t2 - t1);
+        const QPointF a3 = (p2.pos * (t3 - t) + p3.pos * (t - t2)) / (t3 - t2);
+        const QPointF b1 = (a1 * (t2 - t) + a2 * (t - t0)) / (t2 - t0);
+        const QPointF b2 = (a2 * (t3 - t) + a3 * (t - t1)) / (t3 - t1);
+        return (b1 * (t2 - t) + b2 * (t - t1)) / (t2 - t1);
+    };
+
+    // Отклонение середины кривой от хорды убывает как 1/n^2 при n отрезках,
+    // поэтому прямые участки почти не дробятся, а крутые повороты - сильно
+    const qreal chord = distance(p1.pos, p2.pos);
+    const QPointF middle = evaluate((t1 + t2) / 2.0);
+    const qreal deviation = distance(middle, (p1.pos + p2.pos) / 2.0);
+    int steps = qCeil(qSqrt(deviation / STROKE_CURVE_TOLERANCE));
+    steps = qBound(1, steps, qMax(1, qCeil(chord)));
+
+    for (int i = 1; i <= steps; ++i) {
+        const qreal u = i / qreal(steps);
+        StrokeSample sample = p2;
+        if (i < steps) {
+            sample.pos = evaluate(t1 + (t2 - t1) * u);
+            sample.pressure = p1.pressure + (p2.pressure - p1.pressure) * u;
+            sample.timestamp = p1.timestamp + qint64((p2.timestamp - p1.timestamp) * u);
+            sample.xTilt = p1.xTilt + (p2.xTilt - p1.xTilt) * u;
+            sample.yTilt = p1.yTilt + (p2.yTilt - p1.yTilt) * u;
+        }
+        out.append(sample);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef STROKEINTERPOLATOR_H
+#define STROKEINTERPOLATOR_H
+
+#include <QVector>
+#include "StrokeSample.h"
+
+// Проводит центростремительную кривую Катмулла-Рома через отсчеты штриха
+// и разбивает ее на отрезки с шагом, зависящим от кривизны.
+// Отрезок между двумя отсчетами можно построить только после прихода
+// следующего, поэтому кривая отстает от ввода на один отсчет.
+class StrokeInterpolator
+{
+public:
+    void reset(const StrokeSample& first);
+
+    // Точки кривой, которые стали известны после этих отсчетов (без начальной)
+    QVector<StrokeSample> addSamples(const QVector<StrokeSample>& samples);
+    // Достраивает хвост штриха при отпускании
+    QVector<StrokeSample> finish(const StrokeSample& last);
+
+private:
+    bool addKnot(const StrokeSample& sample);
+    // Отрезок кривой p1 -> p2 с соседними узлами p0 и p3
+    void emitSegment(const StrokeSample& p0, const StrokeSample& p1,
+                     const StrokeSample& p2, const StrokeSample& p3,
+                     QVector<StrokeSample>& out) const;
+
+    QVector<StrokeSample> m_knots;  // не больше четырех последних узлов
+    bool m_finished = true;
+};
+
+#endif // STROKEINTERPOLATOR_H
@@ -0,0 +1,96 @@
+#include "StrokePredictor.h"
+#include <QLineF>
+#include "Config.h"
+
+void StrokePredictor::reset()
+{
+    m_samples.clear();
+}
+
+void StrokePredictor::addSamples(const QVector<StrokeSample>& samples)
+{
+    for (const StrokeSample& sample : samples)
+        addSample(sample);
+}
+
+void StrokePredictor::addSample(const StrokeSample& sample)
+{
+    // Отсчеты с тем же временем не несут информации о скорости
+    if (!m_samples.isEmpty() && sample.timestamp <= m_samples.last().timestamp) {
+        m_samples.last().pos = sample.pos;
+        return;
+    }
+
+    m_samples.append(sample);
+    if (m_samples.size() > STROKE_PREDICTION_SAMPLES)
+        m_samples.removeFirst();
+}
+
+bool StrokePredictor::estimate(QPointF& velocity, QPointF& acceleration) const
+{
+    if (m_samples.size() < 2)
+        return false;
+
+    const StrokeSample& first = m_samples.first();
+    const StrokeSample& last = m_samples.last();
+    const qreal span = qreal(last.timestamp - first.timestamp);
+    if (span <= 0.0)
+        return false;
+
+    // Скорость по последнему отрезку, ускорение - по разнице скоростей половин окна
+    const StrokeSample& prev = m_samples[m_samples.size() - 2];
+    velocity = (last.pos - prev.pos) / qreal(last.timestamp - prev.timestamp);
+    acceleration = QPointF();
+
+    if (m_samples.size() >= 3) {
+        const StrokeSample& mid = m_samples[m_samples.size() / 2];
+        const qreal dt1 = qreal(mid.timestamp - first.timestamp);
+        const qreal dt2 = qreal(last.timestamp - mid.timestamp);
+        if (dt1 > 0.0 && dt2 > 0.0) {
+            const QPointF v1 = (mid.pos - first.pos) / dt1;
+            const QPointF v2 = (last.pos - mid.pos) / dt2;
+            acceleration = (v2 - v1) / (span / 2.0);
+        }
+    }
+    return true;
+}
+
+QPolygonF StrokePredictor::predict(qreal horizonMs) const
+{
+    QPointF velocity;
+    QPointF acceleration;
+    if (horizonMs <= 0.0 || !estimate(velocity, acceleration))
+        return QPolygonF();
+
+    const QPointF origin = m_samples.last().pos;
+    QPolygonF path;
+    path << origin;
+
+    // Ускорение берется с затуханием: резкие развороты иначе дают выбросы
+    const int steps = 3;
+    for (int i = 1; i <= steps; ++i) {
+        const qreal t = horizonMs * i / steps;
+        QPointF offset = velocity * t + acceleration * (0.25 * t * t);
+
+        const qreal length = QLineF(QPointF(), offset).length();
+        if (length > STROKE_PREDICTION_MAX_DISTANCE)
+            offset *= STROKE_PREDICTION_MAX_DISTANCE / length;
+
+        path << origin + offset;
+    }
+    return path;
+}
+
+qreal StrokePredictor::predictedLeadMs(qreal horizonMs) const
+{
+    QPointF velocity;
+    QPointF acceleration;
+    if (!estimate(velocity, acceleration))
+        return 0.0;
+
+    const qreal speed = QLineF(QPointF(), velocity).length();
+    if (speed <= 0.0)
+        return 0.0;
+
+    return qMin(horizonMs, STROKE_PREDICTION_MAX_DISTANCE / speed);
+}
@@ -0,0 +1,30 @@
+#ifndef STROKEPREDICTOR_H
+#define STROKEPREDICTOR_H
+
+#include <QPolygonF>
+#include <QVector>
+#include "StrokeSample.h"
+
+// Экстраполирует несколько последних отсчетов штриха на короткое время вперед.
+// Результат рисуется только поверх холста и никогда не попадает в слой.
+class StrokePredictor
+{
+public:
+    void reset();
+    void addSamples(const QVector<StrokeSample>& samples);
+    void addSample(const StrokeSample& sample);
+
+    // Путь от последнего реального отсчета до предсказанной точки через horizonMs.
+    // Пустой, если данных для прогноза недостаточно.
+    QPolygonF predict(qreal horizonMs) const;
+
+    // На сколько миллисекунд вперед реально заглядывает последний прогноз
+    qreal predictedLeadMs(qreal horizonMs) const;
+
+private:
+    bool estimate(QPointF& velocity, QPointF& acceleration) const;
+
+    QVector<StrokeSample> m_samples;
+};
+
+#endif // STROKEPREDICTOR_H
@@ -0,0 +1,20 @@
+#ifndef STROKESAMPLE_H
+#define STROKESAMPLE_H
+
+#include <QPoint>
+#include <QPointF>
+
+// Один отсчет ввода в координатах изображения
+struct StrokeSample
+{
+    QPointF pos;            // субпиксельная позиция
+    qint64 timestamp = 0;   // время события, мс
+    qreal pressure = 1.0;
+    qreal xTilt = 0.0;
+    qreal yTilt = 0.0;
+
+    // Пиксель, на который приходится отсчет
+    QPoint pixel() const { return QPoint(int(pos.x()), int(pos.y())); }
+};
+
+#endif // STROKESAMPLE_H
@@ -25,6 +25,11 @@ void ToolManager::setBrushSize(int size)
     }
 }
 
+void ToolManager::setUsePressure(bool use)
+{
+    m_usePressure = use;
+}
+
 void ToolManager::setTolerance(int value)
 {
     if (m_tolerance == value)
@@ -32,3 +37,39 @@ void ToolManager::setTolerance(int value)
 
     m_tolerance = value;
 }
+
+void ToolManager::setFillMode(FillMode mode)
+{
+    m_fillMode = mode;
+}
+
+void ToolManager::setSampleMerged(bool merged)
+{
+    m_sampleMerged = merged;
+}
+
+void ToolManager::setEyedropperSize(int size)
+{
+    // Квадрат всегда нечетный, чтобы центр приходился на пиксель под курсором
+    m_eyedropperSize = qMax(1, size | 1);
+}
+
+void ToolManager::setSelectionAntialias(bool antialias)
+{
+    m_selectionAntialias = antialias;
+}
+
+void ToolManager::setGradientShape(GradientShape shape)
+{
+    m_gradientShape = shape;
+}
+
+void ToolManager::setGradientDither(bool dither)
+{
+    m_gradientDither = dither;
+}
+
+void ToolManager::setPixelPerfect(bool enabled)
+{
+    m_pixelPerfect = enabled;
+}
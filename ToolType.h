@@ -9,7 +9,26 @@ enum class ToolType {
     Brush,
     Line,
     Rectangle,
-    Ellipse
+    Ellipse,
+    RectSelect,
+    EllipseSelect,
+    Lasso,
+    MagicWand,
+    Transform,
+    Gradient
+};
+
+// Режим заливки: связная область или все похожие пиксели слоя
+enum class FillMode {
+    Contiguous,
+    Global
+};
+
+// Форма градиента
+enum class GradientShape {
+    Linear,
+    Radial,
+    Angular
 };
 
 #endif // TOOLTYPE_H
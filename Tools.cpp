@@ -3,36 +3,153 @@
 #include "Layer.h"
 #include "Commands.h"
 #include "ColorManager.h"
+#include "FloodFill.h"
+#include "RegionLabelCache.h"
+#include "StrokeBuffer.h"
+#include "PixelOps.h"
+#include "Resample.h"
+#include "Config.h"
 #include <QDebug>
-#include <QStack>
+#include <QKeyEvent>
+#include <QtMath>
 #include <QPoint>
+#include <QPolygonF>
 #include <qapplication.h>
 #include <qpainter.h>
 
+// Нажим отсчета с учетом настройки "Нажим"; у мыши он всегда 1
+static qreal samplePressure(const ToolManager* tools, const StrokeSample& sample)
+{
+    if (!tools || !tools->usePressure())
+        return 1.0;
+    return qBound(0.0, sample.pressure, 1.0);
+}
+
+// Нажим квантуется, иначе у планшета каждый отрезок получал бы свое перо
+static qreal pressureLevel(qreal lastPressure, qreal pressure)
+{
+    return qRound((lastPressure + pressure) * 16.0) / 32.0;
+}
+
+// Границы отрезков от lastPos через все отсчеты с запасом на толщину пера
+static QRect strokeBounds(const QPointF& lastPos, const QVector<StrokeSample>& samples, int brushSize)
+{
+    qreal left = lastPos.x(), right = lastPos.x();
+    qreal top = lastPos.y(), bottom = lastPos.y();
+    for (const StrokeSample& sample : samples) {
+        left = qMin(left, sample.pos.x());
+        right = qMax(right, sample.pos.x());
+        top = qMin(top, sample.pos.y());
+        bottom = qMax(bottom, sample.pos.y());
+    }
+
+    const QRect bounds = QRectF(QPointF(left, top), QPointF(right, bottom)).toAlignedRect();
+    return bounds.adjusted(-brushSize, -brushSize, brushSize, brushSize);
+}
+
+// Рисует отрезки от lastPos через все отсчеты. Соседние отрезки с одинаковой
+// толщиной и прозрачностью объединяются в одну ломаную, так что без нажима
+// весь кадр по-прежнему рисуется одним вызовом drawPolyline.
+static void drawPressurePolyline(QPainter& painter, const QColor& color, int brushSize,
+                                 const ToolManager* tools, const QVector<StrokeSample>& samples,
+                                 QPointF& lastPos, qreal& lastPressure)
+{
+    QPolygonF run;
+    run.reserve(samples.size() + 1);
+    run << lastPos;
+
+    int runWidth = -1;
+    int runAlpha = -1;
+
+    auto flushRun = [&]() {
+        if (run.size() < 2)
+            return;
+        QColor runColor = color;
+        runColor.setAlpha(runAlpha);
+        painter.setPen(QPen(runColor, runWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+        painter.drawPolyline(run);
+    };
+
+    for (const StrokeSample& sample : samples) {
+        const qreal pressure = samplePressure(tools, sample);
+        const qreal level = pressureLevel(lastPressure, pressure);
+        const int width = qMax(1, qRound(brushSize * level));
+        const int alpha = qRound(color.alpha() * level);
+
+        if (width != runWidth || alpha != runAlpha) {
+            flushRun();
+            const QPointF tail = run.last();
+            run.clear();
+            run << tail;
+            runWidth = width;
+            runAlpha = alpha;
+        }
+
+        run << sample.pos;
+        lastPos = sample.pos;
+        lastPressure = pressure;
+    }
+    flushRun();
+}
+
+// Сливает законченный штрих со слоем одной правкой; снимок для истории
+// берется только под границами штриха
+static void commitStroke(LayerManager* layers, CommandManager* commands, StrokeBuffer& stroke)
+{
+    const QRect bounds = stroke.bounds();
+    PaintSession session;
+    if (!bounds.isEmpty() && session.begin(layers, bounds) && session.layer()->id() == stroke.layerId()) {
+        stroke.composite(session.layer()->image(), QPoint(), bounds);
+        session.commitPixels(bounds);
+        session.finish(commands);
+    }
+    stroke.clear();
+}
+
 // -------------------
 // EyedropperTool
 // -------------------
-EyedropperTool::EyedropperTool(LayerManager* layers, ColorManager* colors, QObject* parent)
+EyedropperTool::EyedropperTool(LayerManager* layers, ColorManager* colors, ToolManager* tools, QObject* parent)
     : Tool(parent)
     , m_layerManager(layers)
     , m_colorManager(colors)
+    , m_toolManager(tools)
 {
 }
 
-void EyedropperTool::mousePress(const QPoint& pos)
+void EyedropperTool::mousePress(const StrokeSample& sample)
 {
+    const QPoint pos = sample.pixel();
     if (!m_layerManager || !m_colorManager) return;
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    const bool merged = m_toolManager && m_toolManager->sampleMerged();
+    const Layer* layer = m_layerManager->layerAt(m_layerManager->activeLayerIndex());
+    if (!merged && !layer) return;
 
-    QImage img = layer->image();
+    // Композит берется из кэша LayerManager, а не собирается на каждый щелчок
+    const QImage& img = merged ? m_layerManager->mergedImage() : layer->image();
     if (pos.x() < 0 || pos.y() < 0 || pos.x() >= img.width() || pos.y() >= img.height())
         return;
 
-    QColor pickedColor = img.pixelColor(pos);
-    m_colorManager->setPrimaryColor(pickedColor);
+    const int radius = (m_toolManager ? m_toolManager->eyedropperSize() : 1) / 2;
+    const QRect area = QRect(pos - QPoint(radius, radius), QSize(2 * radius + 1, 2 * radius + 1)) & img.rect();
+
+    // Усреднение по premultiplied каналам: прозрачные пиксели не тянут цвет к черному
+    quint64 alpha = 0, red = 0, green = 0, blue = 0;
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(img.constScanLine(y));
+        for (int x = area.left(); x <= area.right(); ++x) {
+            alpha += qAlpha(line[x]);
+            red += qRed(line[x]);
+            green += qGreen(line[x]);
+            blue += qBlue(line[x]);
+        }
+    }
+
+    const quint64 count = quint64(area.width()) * area.height();
+    auto average = [count](quint64 sum) { return int((sum + count / 2) / count); };
+    const QRgb premultiplied = qRgba(average(red), average(green), average(blue), average(alpha));
+    m_colorManager->setPrimaryColor(QColor::fromRgba(qUnpremultiply(premultiplied)));
 }
 
 // -------------------
@@ -48,49 +165,86 @@ PencilTool::PencilTool(LayerManager* layers, CommandManager* commands, ColorMana
 }
 
 
-void PencilTool::mousePress(const QPoint& pos)
+void PencilTool::mousePress(const StrokeSample& sample)
 {
     if (!m_layerManager || !m_commandManager || !m_colorManager) return;
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    // Слой не меняется до отпускания: штрих копится в черновике
+    if (!m_stroke.begin(m_layerManager, m_colorManager->primaryColor(), StrokeBuffer::Mode::Paint)) return;
 
     m_drawing = true;
-    m_lastPos = pos;
-    m_startImage = layer->image();
+    m_lastPos = sample.pos;
+    m_lastPressure = samplePressure(m_toolManager, sample);
+    m_interpolator.reset(sample);
+
+    // Маленький жесткий карандаш рисуется по пикселям, без QPainter
+    const int brushSize = m_toolManager->brushSize();
+    m_pixelPath = brushSize <= PENCIL_PIXEL_MAX_SIZE;
+    if (m_pixelPath) {
+        const qreal level = pressureLevel(m_lastPressure, m_lastPressure);
+        const QRect dirty = m_pixels.begin(m_stroke, sample.pixel(), qMax(1, qRound(brushSize * level)),
+                                           quint32(qRound(256 * level)), m_toolManager->pixelPerfect());
+        if (!dirty.isEmpty())
+            emit overlayChanged(dirty);
+    }
 }
 
-void PencilTool::mouseMove(const QPoint& pos)
+void PencilTool::mouseMove(const QVector<StrokeSample>& samples)
 {
-    if (!m_drawing || !m_layerManager || !m_colorManager || !m_toolManager) return;
+    if (!m_drawing) return;
+    drawSamples(m_interpolator.addSamples(samples));
+}
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+void PencilTool::drawSamples(const QVector<StrokeSample>& samples)
+{
+    if (!m_layerManager || !m_colorManager || !m_toolManager || samples.isEmpty()) return;
 
-    QPainter painter(&layer->image());
     int brushSize = m_toolManager->brushSize(); // берём размер кисти из ToolManager
-    painter.setPen(QPen(m_colorManager->primaryColor(), brushSize, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-    painter.drawLine(m_lastPos, pos);
-    m_lastPos = pos;
+    QRect dirty;
+    if (m_pixelPath) {
+        // Линия по Брезенхэму между пикселями отсчетов, штамп пишется прямо в плитки черновика
+        for (const StrokeSample& sample : samples) {
+            const qreal pressure = samplePressure(m_toolManager, sample);
+            const qreal level = pressureLevel(m_lastPressure, pressure);
+            dirty |= m_pixels.lineTo(m_stroke, sample.pixel(), qMax(1, qRound(brushSize * level)),
+                                     quint32(qRound(256 * level)));
+            m_lastPos = sample.pos;
+            m_lastPressure = pressure;
+        }
+    } else {
+        // Все отсчеты кадра рисуются одним QPainter; нажим меняет толщину и прозрачность.
+        // В черновик пишется только покрытие, цвет штриха задан при нажатии.
+        dirty = m_stroke.paint(strokeBounds(m_lastPos, samples, brushSize), [&](QPainter& painter) {
+            drawPressurePolyline(painter, Qt::black, brushSize, m_toolManager, samples, m_lastPos, m_lastPressure);
+        });
+    }
 
-    m_layerManager->layersChanged();
+    if (!dirty.isEmpty())
+        emit overlayChanged(dirty);
 }
 
 
-void PencilTool::mouseRelease(const QPoint& pos)
+void PencilTool::mouseRelease(const StrokeSample& sample)
 {
     if (!m_drawing || !m_layerManager || !m_commandManager || !m_colorManager) return;
 
     m_drawing = false;
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    // Хвост кривой до точки отпускания
+    drawSamples(m_interpolator.finish(sample));
+    if (m_pixelPath)
+        m_pixels.finish(m_stroke);
+    commitStroke(m_layerManager, m_commandManager, m_stroke);
+}
 
-    QImage newImage = layer->image();
-    auto* cmd = new DrawCommand(m_layerManager, activeIndex, m_startImage, newImage);
-    m_commandManager->ExecuteCommand(cmd);
+void PencilTool::paintPrediction(QPainter& painter, const QPolygonF& path)
+{
+    if (!m_drawing || !m_colorManager || !m_toolManager) return;
+
+    painter.setPen(QPen(m_colorManager->primaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    // Кривая отстает на один отсчет: прогноз начинается от ее конца
+    QPolygonF full;
+    full << m_lastPos << path;
+    painter.drawPolyline(full);
 }
 
 // -------------------
@@ -102,68 +256,125 @@ FillTool::FillTool(LayerManager* layers, CommandManager* commands, ColorManager*
     , m_commandManager(commands)
     , m_colorManager(colors)
     , m_toolManager(tools)
+    , m_regionCache(new RegionLabelCache(layers, this))
 {
+    // После переразметки прежний номер под курсором ничего не значит
+    connect(m_regionCache, &RegionLabelCache::labelsChanged, this, &FillTool::clearHover);
 }
 
-void FillTool::mousePress(const QPoint& pos)
+bool FillTool::syncRegionCache()
 {
-    if (!m_layerManager || !m_commandManager || !m_colorManager) return;
+    if (!m_layerManager || !m_toolManager || m_toolManager->fillMode() != FillMode::Contiguous)
+        return false;
+    // Разметка совпадает с заливкой от точки щелчка только без допуска
+    if (m_toolManager->tolerance() != 0)
+        return false;
+
+    const Layer* layer = m_layerManager->layerAt(m_layerManager->activeLayerIndex());
+    if (!layer)
+        return false;
+
+    m_regionCache->setSource(m_toolManager->sampleMerged() ? 0 : layer->id());
+    return true;
+}
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+void FillTool::clearHover()
+{
+    if (m_hoverRect.isEmpty())
+        return;
 
-    m_startImage = layer->image();
-    floodFill(layer->image(), pos, m_colorManager->primaryColor());
-    m_layerManager->layersChanged();
+    const QRect old = m_hoverRect;
+    m_hoverLabel = 0;
+    m_hoverRect = QRect();
+    m_hoverOverlayRect = QRect();
+    m_hoverOverlay = QImage();
+    emit overlayChanged(old);
 }
 
-void FillTool::mouseRelease(const QPoint& pos)
+void FillTool::hoverMove(const StrokeSample& sample)
 {
-    Q_UNUSED(pos)
-    if (!m_layerManager || !m_commandManager) return;
+    if (!syncRegionCache()) {
+        clearHover();
+        return;
+    }
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    const quint32 label = m_regionCache->labelAt(sample.pixel());
+    if (label == m_hoverLabel)
+        return;
+
+    clearHover();
+    if (label == 0)
+        return;
 
-    auto* cmd = new DrawCommand(m_layerManager, activeIndex, m_startImage, layer->image());
-    m_commandManager->ExecuteCommand(cmd);
+    m_hoverLabel = label;
+    m_hoverRect = m_regionCache->regionBounds(label);
+    emit overlayChanged(m_hoverRect);
 }
 
-void FillTool::floodFill(QImage& image, const QPoint& start, const QColor& color)
+void FillTool::paintOverlay(QPainter& painter)
 {
-    if (start.x() < 0 || start.y() < 0 || start.x() >= image.width() || start.y() >= image.height())
+    if (m_hoverLabel == 0 || m_hoverRect.isEmpty())
         return;
 
-    int tolerance = m_toolManager->tolerance();
-    QColor targetColor = image.pixelColor(start);
+    // Маска строится при отрисовке и только для перерисовываемой части области:
+    // у фона или большого контура она могла бы быть размером со все изображение
+    const QRect visible = painter.hasClipping()
+        ? m_hoverRect & painter.clipBoundingRect().toAlignedRect()
+        : m_hoverRect;
+    if (visible.isEmpty())
+        return;
 
-    auto withinTolerance = [&](const QColor& a, const QColor& b) {
-        return (std::abs(a.red()   - b.red())   <= tolerance &&
-                std::abs(a.green() - b.green()) <= tolerance &&
-                std::abs(a.blue()  - b.blue())  <= tolerance);
-    };
+    if (!m_hoverOverlayRect.contains(visible)) {
+        m_hoverOverlayRect = visible;
+        m_hoverOverlay = m_regionCache->regionOverlay(m_hoverLabel, qPremultiply(FILL_HOVER_COLOR.rgba()), visible);
+    }
+    if (!m_hoverOverlay.isNull())
+        painter.drawImage(m_hoverOverlayRect.topLeft(), m_hoverOverlay);
+}
 
-    if (withinTolerance(targetColor, color))
-        return;
-    QStack<QPoint> stack;
-    stack.push(start);
-
-    while (!stack.isEmpty()) {
-        QPoint p = stack.pop();
-        if (p.x() < 0 || p.y() < 0 || p.x() >= image.width() || p.y() >= image.height())
-            continue;
-        if (!withinTolerance(image.pixelColor(p), targetColor))
-            continue;
-
-        image.setPixelColor(p, color);
-
-        stack.push(QPoint(p.x() + 1, p.y()));
-        stack.push(QPoint(p.x() - 1, p.y()));
-        stack.push(QPoint(p.x(), p.y() + 1));
-        stack.push(QPoint(p.x(), p.y() - 1));
+void FillTool::mousePress(const StrokeSample& sample)
+{
+    const QPoint pos = sample.pixel();
+    if (!m_layerManager || !m_commandManager || !m_colorManager || !m_toolManager) return;
+
+    // Щелчок вне выделения ничего не заливает
+    const Selection& selection = m_layerManager->selection();
+    if (!selection.isEmpty() && selection.coverage(pos.x(), pos.y()) == 0) return;
+    if (!m_session.begin(m_layerManager)) return;
+
+    QImage& image = m_session.layer()->image();
+    const QColor color = m_colorManager->primaryColor();
+    const int tolerance = m_toolManager->tolerance();
+    const QRect clip = m_session.clip();
+    // Область ищется по видимому изображению, а заливается активный слой
+    const QImage& reference = m_toolManager->sampleMerged() ? m_layerManager->mergedImage() : image;
+
+    // В историю попадают только измененные участки, а не весь слой
+    QVector<QRect> changed;
+    if (m_toolManager->fillMode() == FillMode::Global) {
+        changed = FloodFill::replaceColor(image, reference, pos, color, tolerance, clip);
+    } else if (const quint32 label = syncRegionCache() ? m_regionCache->labelAt(pos) : 0) {
+        // Разметка готова: заливка - это поиск номера области и запись по маске
+        const QRgb fillPixel = qPremultiply(color.rgba());
+        const bool alreadyFilled = !m_toolManager->sampleMerged()
+            && reinterpret_cast<const QRgb*>(image.constScanLine(pos.y()))[pos.x()] == fillPixel;
+        if (!alreadyFilled)
+            changed.append(m_regionCache->fillRegion(image, label, fillPixel, clip));
+    } else {
+        changed.append(FloodFill::fill(image, reference, pos, color, tolerance, clip));
     }
+    clearHover();
+
+    LayerManager::BatchScope batch(m_layerManager);
+    for (const QRect& rect : changed)
+        m_session.commitPixels(rect);
+}
+
+void FillTool::mouseRelease(const StrokeSample& sample)
+{
+    Q_UNUSED(sample)
+    if (m_session.isActive())
+        m_session.finish(m_commandManager);
 }
 
 // -------------------
@@ -178,73 +389,69 @@ BrushTool::BrushTool(LayerManager* layers, CommandManager* commands, ColorManage
 {
 }
 
-void BrushTool::mousePress(const QPoint& pos)
+void BrushTool::mousePress(const StrokeSample& sample)
 {
     if (!m_layerManager || !m_commandManager || !m_colorManager) return;
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    // Слой не меняется до отпускания: отпечатки копятся в черновике
+    if (!m_stroke.begin(m_layerManager, m_colorManager->primaryColor(), StrokeBuffer::Mode::Paint)) return;
 
     m_drawing = true;
-    m_lastPos = pos;
-    m_startImage = layer->image();
+    m_lastPos = sample.pos;
+    m_lastPressure = samplePressure(m_toolManager, sample);
+    m_interpolator.reset(sample);
+    m_engine.beginStroke(m_lastPos, m_lastPressure);
 }
 
-void BrushTool::mouseMove(const QPoint& pos)
+void BrushTool::mouseMove(const QVector<StrokeSample>& samples)
 {
-    if (!m_drawing || !m_layerManager || !m_colorManager || !m_toolManager) return;
-
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
-
-    int brushSize = m_toolManager->brushSize();
-    QColor color = m_colorManager->primaryColor();
-
-    QPainter painter(&layer->image());
-    painter.setRenderHint(QPainter::Antialiasing, true);
-
-    const int steps = qMax(1, (pos - m_lastPos).manhattanLength() / 4);
-    for (int i = 0; i <= steps; ++i) {
-        qreal t = i / qreal(steps);
-        QPointF point = m_lastPos * (1 - t) + pos * t;
-
-        QRadialGradient gradient(point, brushSize / 2.0);
+    if (!m_drawing) return;
+    drawSamples(m_interpolator.addSamples(samples));
+}
 
-        const qreal k = 2.0;
+void BrushTool::drawSamples(const QVector<StrokeSample>& samples)
+{
+    if (!m_layerManager || !m_colorManager || !m_toolManager || samples.isEmpty()) return;
 
-        const int stepsGradient = 10;
-        for (int j = 0; j <= stepsGradient; ++j) {
-            qreal g = j / qreal(stepsGradient);
-            qreal alpha = qPow(1.0 - g, k) * 255;
-            QColor stepColor = color;
-            stepColor.setAlpha(int(alpha));
-            gradient.setColorAt(g, stepColor);
-        }
+    // Отпечатки берутся из кэша движка; размер мог смениться между кадрами
+    m_engine.setBrush(m_toolManager->brushSize(), BRUSH_HARDNESS);
 
-        painter.setBrush(gradient);
-        painter.setPen(Qt::NoPen);
-        painter.drawEllipse(point, brushSize / 2.0, brushSize / 2.0);
+    QRect dirty;
+    for (const StrokeSample& sample : samples) {
+        const qreal pressure = samplePressure(m_toolManager, sample);
+        dirty |= m_engine.strokeTo(m_stroke, sample.pos, pressure);
+        m_lastPos = sample.pos;
+        m_lastPressure = pressure;
     }
 
-
-    m_lastPos = pos;
-    m_layerManager->layersChanged();
+    if (!dirty.isEmpty())
+        emit overlayChanged(dirty);
 }
 
-void BrushTool::mouseRelease(const QPoint& pos)
+void BrushTool::mouseRelease(const StrokeSample& sample)
 {
     if (!m_drawing || !m_layerManager || !m_commandManager || !m_colorManager) return;
 
     m_drawing = false;
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    // Хвост кривой до точки отпускания
+    drawSamples(m_interpolator.finish(sample));
+    commitStroke(m_layerManager, m_commandManager, m_stroke);
+}
+
+
+void BrushTool::paintPrediction(QPainter& painter, const QPolygonF& path)
+{
+    if (!m_drawing || !m_colorManager || !m_toolManager) return;
 
-    QImage newImage = layer->image();
-    auto* cmd = new DrawCommand(m_layerManager, activeIndex, m_startImage, newImage);
-    m_commandManager->ExecuteCommand(cmd);
+    // Упрощенное изображение мягкой кисти: полупрозрачная линия
+    QColor color = m_colorManager->primaryColor();
+    color.setAlpha(color.alpha() / 2);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(QPen(color, m_toolManager->brushSize() * 0.6, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    // Кривая отстает на один отсчет: прогноз начинается от ее конца
+    QPolygonF full;
+    full << m_lastPos << path;
+    painter.drawPolyline(full);
 }
 
 
@@ -259,49 +466,83 @@ EraserTool::EraserTool(LayerManager* layers, CommandManager* commands, ToolManag
 {
 }
 
-void EraserTool::mousePress(const QPoint& pos)
+void EraserTool::mousePress(const StrokeSample& sample)
 {
     if (!m_layerManager || !m_commandManager) return;
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    // Слой не меняется до отпускания: стирание копится в черновике
+    if (!m_stroke.begin(m_layerManager, Qt::black, StrokeBuffer::Mode::Erase)) return;
 
     m_erasing = true;
-    m_lastPos = pos;
-    m_startImage = layer->image();
+    m_lastPos = sample.pos;
+    m_lastPressure = samplePressure(m_toolManager, sample);
+    m_interpolator.reset(sample);
 }
 
-void EraserTool::mouseMove(const QPoint& pos)
+void EraserTool::mouseMove(const QVector<StrokeSample>& samples)
 {
-    if (!m_erasing || !m_layerManager || !m_toolManager) return;
+    if (!m_erasing) return;
+    drawSamples(m_interpolator.addSamples(samples));
+}
 
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+void EraserTool::drawSamples(const QVector<StrokeSample>& samples)
+{
+    if (!m_layerManager || !m_toolManager || samples.isEmpty()) return;
 
-    QPainter painter(&layer->image());
     int brushSize = m_toolManager->brushSize();
-    painter.setCompositionMode(QPainter::CompositionMode_Clear); // стираем пиксели
-    painter.setPen(QPen(Qt::transparent, brushSize, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-    painter.drawLine(m_lastPos, pos);
-    m_lastPos = pos;
+    // Покрытие черновика при слиянии вычитается из альфы слоя
+    const QRect dirty = m_stroke.paint(strokeBounds(m_lastPos, samples, brushSize), [&](QPainter& painter) {
+        drawPressurePolyline(painter, Qt::black, brushSize, m_toolManager, samples, m_lastPos, m_lastPressure);
+    });
 
-    m_layerManager->layersChanged();
+    if (!dirty.isEmpty())
+        emit overlayChanged(dirty);
 }
 
-void EraserTool::mouseRelease(const QPoint& pos)
+void EraserTool::mouseRelease(const StrokeSample& sample)
 {
     if (!m_erasing || !m_layerManager || !m_commandManager) return;
 
     m_erasing = false;
-    int activeIndex = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(activeIndex);
-    if (!layer) return;
+    // Хвост кривой до точки отпускания
+    drawSamples(m_interpolator.finish(sample));
+    commitStroke(m_layerManager, m_commandManager, m_stroke);
+}
 
-    QImage newImage = layer->image();
-    auto* cmd = new DrawCommand(m_layerManager, activeIndex, m_startImage, newImage);
-    m_commandManager->ExecuteCommand(cmd);
+// Фигура рисуется в слой один раз, при отпускании; снимок для истории
+// берется только под ее границами
+template <typename Draw>
+static void commitShape(LayerManager* layers, CommandManager* commands, const QRect& bounds, Draw draw)
+{
+    PaintSession session;
+    if (bounds.isEmpty() || !session.begin(layers, bounds))
+        return;
+
+    {
+        QPainter painter(&session.layer()->image());
+        painter.setClipRect(session.clip());
+        draw(painter);
+    }
+    session.commitPixels(bounds);
+    session.finish(commands);
+}
+
+// Предпросмотр фигуры рисуется прямо на виджете тем же draw, что и commitShape,
+// и обрезается так же: границами фигуры и выделением
+template <typename Draw>
+static void paintShapePreview(QPainter& painter, const LayerManager* layers, const QRect& bounds, Draw draw)
+{
+    QRect clip = bounds;
+    const Selection& selection = layers->selection();
+    if (!selection.isEmpty())
+        clip &= selection.bounds();
+    if (clip.isEmpty())
+        return;
+
+    painter.save();
+    painter.setClipRect(clip, Qt::IntersectClip);
+    draw(painter);
+    painter.restore();
 }
 
 // -------------------
@@ -312,62 +553,61 @@ LineTool::LineTool(LayerManager* lm, CommandManager* cm, ColorManager* col, Tool
 {
 }
 
-void LineTool::mousePress(const QPoint& pos)
+void LineTool::mousePress(const StrokeSample& sample)
 {
-    if (!m_layerManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
+    const QPoint pos = sample.pixel();
+    if (!m_layerManager || !m_colorManager || !m_toolManager) return;
+    if (!m_layerManager->layerAt(m_layerManager->activeLayerIndex())) return;
 
     m_startPos = pos;
     m_lastPos = pos;
-    m_startImage = layer->image().copy(); // обязательно copy()
     m_drawing = true;
+    updateOverlay();
 }
 
-void LineTool::mouseMove(const QPoint& pos)
+void LineTool::mouseMove(const QVector<StrokeSample>& samples)
 {
-    if (!m_drawing || !m_layerManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
-
-    m_lastPos = pos;
+    // Для фигуры важен только последний отсчет кадра
+    if (!m_drawing || samples.isEmpty()) return;
 
-    QImage tmp = m_startImage;
-    {
-        QPainter p(&tmp);
-        p.setRenderHint(QPainter::Antialiasing);
-        p.setPen(QPen(m_colorManager->primaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-        p.drawLine(m_startPos, m_lastPos);
-    }
-
-    layer->setImage(tmp);
-    m_layerManager->layersChanged();
+    m_lastPos = samples.last().pixel();
+    updateOverlay();
 }
 
-void LineTool::mouseRelease(const QPoint& pos)
+void LineTool::mouseRelease(const StrokeSample& sample)
 {
-    if (!m_drawing || !m_layerManager || !m_commandManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
+    if (!m_drawing) return;
 
-    m_lastPos = pos;
+    m_lastPos = sample.pixel();
     m_drawing = false;
+    commitShape(m_layerManager, m_commandManager, shapeBounds(), [this](QPainter& p) { drawShape(p); });
+    updateOverlay();
+}
 
-    QImage tmp = m_startImage;
-    {
-        QPainter p(&tmp);
-        p.setRenderHint(QPainter::Antialiasing);
-        p.setPen(QPen(m_colorManager->primaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-        p.drawLine(m_startPos, m_lastPos);
-    }
+void LineTool::paintOverlay(QPainter& painter)
+{
+    if (!m_drawing) return;
+    paintShapePreview(painter, m_layerManager, shapeBounds(), [this](QPainter& p) { drawShape(p); });
+}
 
-    layer->setImage(tmp);
-    m_layerManager->layersChanged();
+QRect LineTool::shapeBounds() const
+{
+    const int size = m_toolManager->brushSize();
+    return QRect(m_startPos, m_lastPos).normalized().adjusted(-size, -size, size, size);
+}
+
+void LineTool::drawShape(QPainter& p) const
+{
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setPen(QPen(m_colorManager->primaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    p.drawLine(m_startPos, m_lastPos);
+}
 
-    m_commandManager->ExecuteCommand(new DrawCommand(m_layerManager, idx, m_startImage, tmp));
+void LineTool::updateOverlay()
+{
+    const QRect old = m_shapeRect;
+    m_shapeRect = m_drawing ? shapeBounds() : QRect();
+    emit overlayChanged(old | m_shapeRect);
 }
 
 // -------------------
@@ -394,68 +634,67 @@ RectTool::RectTool(LayerManager* lm, CommandManager* cm, ColorManager* col, Tool
 {
 }
 
-
-
-void RectTool::mousePress(const QPoint& pos)
+void RectTool::mousePress(const StrokeSample& sample)
 {
-    if (!m_layerManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
+    const QPoint pos = sample.pixel();
+    if (!m_layerManager || !m_colorManager || !m_toolManager) return;
+    if (!m_layerManager->layerAt(m_layerManager->activeLayerIndex())) return;
 
     m_startPos = pos;
     m_lastPos = pos;
-    m_startImage = layer->image().copy();
     m_drawing = true;
+    updateOverlay();
 }
 
-void RectTool::mouseMove(const QPoint& pos)
+void RectTool::mouseMove(const QVector<StrokeSample>& samples)
 {
-    if (!m_drawing || !m_layerManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
+    // Для фигуры важен только последний отсчет кадра
+    if (!m_drawing || samples.isEmpty()) return;
 
-    m_lastPos = pos;
+    m_lastPos = samples.last().pixel();
+    updateOverlay();
+}
 
-    QImage tmp = m_startImage;
-    {
-        QPainter p(&tmp);
-        p.setRenderHint(QPainter::Antialiasing, false);
-        p.setPen(QPen(m_colorManager->secondaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::SquareCap, Qt::MiterJoin));
-        p.setBrush(m_colorManager->primaryColor());
-        QRect rect = normalizedSquare(m_startPos, m_lastPos, QApplication::keyboardModifiers() & Qt::ShiftModifier);
-        p.drawRect(rect);
-    }
+void RectTool::mouseRelease(const StrokeSample& sample)
+{
+    if (!m_drawing) return;
 
-    layer->setImage(tmp);
-    m_layerManager->layersChanged();
+    m_lastPos = sample.pixel();
+    m_drawing = false;
+    commitShape(m_layerManager, m_commandManager, shapeBounds(), [this](QPainter& p) { drawShape(p); });
+    updateOverlay();
 }
 
-void RectTool::mouseRelease(const QPoint& pos)
+void RectTool::paintOverlay(QPainter& painter)
 {
-    if (!m_drawing || !m_layerManager || !m_commandManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
+    if (!m_drawing) return;
+    paintShapePreview(painter, m_layerManager, shapeBounds(), [this](QPainter& p) { drawShape(p); });
+}
 
-    m_lastPos = pos;
-    m_drawing = false;
+QRect RectTool::shapeRect() const
+{
+    return normalizedSquare(m_startPos, m_lastPos, QApplication::keyboardModifiers() & Qt::ShiftModifier);
+}
 
-    QImage tmp = m_startImage;
-    {
-        QPainter p(&tmp);
-        p.setRenderHint(QPainter::Antialiasing);
-        p.setPen(QPen(m_colorManager->secondaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::SquareCap, Qt::MiterJoin));
-        p.setBrush(m_colorManager->primaryColor());
-        QRect rect = normalizedSquare(m_startPos, m_lastPos, QApplication::keyboardModifiers() & Qt::ShiftModifier);
-        p.drawRect(rect);
-    }
+QRect RectTool::shapeBounds() const
+{
+    const int size = m_toolManager->brushSize();
+    return shapeRect().adjusted(-size, -size, size, size);
+}
 
-    layer->setImage(tmp);
-    m_layerManager->layersChanged();
+void RectTool::drawShape(QPainter& p) const
+{
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setPen(QPen(m_colorManager->secondaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::SquareCap, Qt::MiterJoin));
+    p.setBrush(m_colorManager->primaryColor());
+    p.drawRect(shapeRect());
+}
 
-    m_commandManager->ExecuteCommand(new DrawCommand(m_layerManager, idx, m_startImage, tmp));
+void RectTool::updateOverlay()
+{
+    const QRect old = m_shapeRect;
+    m_shapeRect = m_drawing ? shapeBounds() : QRect();
+    emit overlayChanged(old | m_shapeRect);
 }
 
 // -------------------
@@ -466,64 +705,570 @@ EllipseTool::EllipseTool(LayerManager* lm, CommandManager* cm, ColorManager* col
 {
 }
 
-void EllipseTool::mousePress(const QPoint& pos)
+void EllipseTool::mousePress(const StrokeSample& sample)
 {
-    if (!m_layerManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
+    const QPoint pos = sample.pixel();
+    if (!m_layerManager || !m_colorManager || !m_toolManager) return;
+    if (!m_layerManager->layerAt(m_layerManager->activeLayerIndex())) return;
 
     m_startPos = pos;
     m_lastPos = pos;
-    m_startImage = layer->image().copy();
     m_drawing = true;
+    updateOverlay();
 }
 
-void EllipseTool::mouseMove(const QPoint& pos)
+void EllipseTool::mouseMove(const QVector<StrokeSample>& samples)
 {
-    if (!m_drawing || !m_layerManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
-    if (!layer) return;
+    // Для фигуры важен только последний отсчет кадра
+    if (!m_drawing || samples.isEmpty()) return;
 
-    m_lastPos = pos;
+    m_lastPos = samples.last().pixel();
+    updateOverlay();
+}
 
-    QImage tmp = m_startImage;
-    {
-        QPainter p(&tmp);
-        p.setRenderHint(QPainter::Antialiasing, false);
-        p.setPen(QPen(m_colorManager->secondaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-        p.setBrush(m_colorManager->primaryColor());
-        QRect rect = normalizedSquare(m_startPos, m_lastPos, QApplication::keyboardModifiers() & Qt::ShiftModifier);
-        p.drawEllipse(rect);
+void EllipseTool::mouseRelease(const StrokeSample& sample)
+{
+    if (!m_drawing) return;
+
+    m_lastPos = sample.pixel();
+    m_drawing = false;
+    commitShape(m_layerManager, m_commandManager, shapeBounds(), [this](QPainter& p) { drawShape(p); });
+    updateOverlay();
+}
+
+void EllipseTool::paintOverlay(QPainter& painter)
+{
+    if (!m_drawing) return;
+    paintShapePreview(painter, m_layerManager, shapeBounds(), [this](QPainter& p) { drawShape(p); });
+}
+
+QRect EllipseTool::shapeRect() const
+{
+    return normalizedSquare(m_startPos, m_lastPos, QApplication::keyboardModifiers() & Qt::ShiftModifier);
+}
+
+QRect EllipseTool::shapeBounds() const
+{
+    const int size = m_toolManager->brushSize();
+    return shapeRect().adjusted(-size, -size, size, size);
+}
+
+void EllipseTool::drawShape(QPainter& p) const
+{
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setPen(QPen(m_colorManager->secondaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    p.setBrush(m_colorManager->primaryColor());
+    p.drawEllipse(shapeRect());
+}
+
+void EllipseTool::updateOverlay()
+{
+    const QRect old = m_shapeRect;
+    m_shapeRect = m_drawing ? shapeBounds() : QRect();
+    emit overlayChanged(old | m_shapeRect);
+}
+
+// -------------------
+// SelectionTool
+// -------------------
+// Shift добавляет к выделению, Alt вычитает из него
+static SelectionOp selectionOpFromModifiers()
+{
+    const Qt::KeyboardModifiers modifiers = QGuiApplication::queryKeyboardModifiers();
+    if (modifiers & Qt::ShiftModifier)
+        return SelectionOp::Add;
+    if (modifiers & Qt::AltModifier)
+        return SelectionOp::Subtract;
+    return SelectionOp::Replace;
+}
+
+SelectionTool::SelectionTool(LayerManager* layers, SelectionShape shape, QObject* parent)
+    : Tool(parent)
+    , m_layerManager(layers)
+    , m_shape(shape)
+{
+}
+
+void SelectionTool::mousePress(const StrokeSample& sample)
+{
+    if (!m_layerManager || m_layerManager->layerCount() == 0) return;
+
+    m_dragging = true;
+    m_startPos = sample.pixel();
+    m_lastPos = m_startPos;
+    m_lasso.clear();
+    m_lasso << sample.pos;
+}
+
+void SelectionTool::mouseMove(const QVector<StrokeSample>& samples)
+{
+    if (!m_dragging || samples.isEmpty()) return;
+
+    m_lastPos = samples.last().pixel();
+    if (m_shape == SelectionShape::Lasso) {
+        for (const StrokeSample& sample : samples) {
+            if ((sample.pos - m_lasso.last()).manhattanLength() >= 1.0)
+                m_lasso << sample.pos;
+        }
     }
+    updateOverlay();
+}
 
-    layer->setImage(tmp);
-    m_layerManager->layersChanged();
+void SelectionTool::mouseRelease(const StrokeSample& sample)
+{
+    if (!m_dragging) return;
+
+    m_dragging = false;
+    m_lastPos = sample.pixel();
+    if (m_shape == SelectionShape::Lasso)
+        m_lasso << sample.pos;
+    updateOverlay();
+
+    const SelectionOp op = selectionOpFromModifiers();
+    const QSize canvas = m_layerManager->layerAt(0)->image().size();
+    Selection shape;
+    switch (m_shape) {
+    case SelectionShape::Rectangle:
+        if (m_startPos != m_lastPos)
+            shape = Selection::fromRect(QRect(m_startPos, m_lastPos), canvas);
+        break;
+    case SelectionShape::Ellipse:
+        if (m_startPos != m_lastPos)
+            shape = Selection::fromEllipse(QRect(m_startPos, m_lastPos), canvas);
+        break;
+    case SelectionShape::Lasso:
+        shape = Selection::fromPolygon(m_lasso, canvas);
+        break;
+    }
+    m_lasso.clear();
+
+    // Щелчок без протягивания снимает выделение
+    if (shape.isEmpty() && op != SelectionOp::Replace)
+        return;
+    m_layerManager->setSelection(m_layerManager->selection().combined(shape, op));
 }
 
-void EllipseTool::mouseRelease(const QPoint& pos)
+void SelectionTool::updateOverlay()
 {
-    if (!m_drawing || !m_layerManager || !m_commandManager) return;
-    int idx = m_layerManager->activeLayerIndex();
-    Layer* layer = m_layerManager->layerAt(idx);
+    const QRect old = m_overlayRect;
+    m_overlayRect = QRect();
+    if (m_dragging) {
+        m_overlayRect = m_shape == SelectionShape::Lasso
+            ? m_lasso.boundingRect().toAlignedRect()
+            : QRect(m_startPos, m_lastPos).normalized();
+        m_overlayRect.adjust(-1, -1, 2, 2);
+    }
+    emit overlayChanged(old | m_overlayRect);
+}
+
+void SelectionTool::paintOverlay(QPainter& painter)
+{
+    if (!m_dragging) return;
+
+    painter.save();
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(QPen(Qt::black, 0, Qt::DashLine));
+    switch (m_shape) {
+    case SelectionShape::Rectangle:
+        painter.drawRect(QRect(m_startPos, m_lastPos).normalized());
+        break;
+    case SelectionShape::Ellipse:
+        painter.drawEllipse(QRect(m_startPos, m_lastPos).normalized());
+        break;
+    case SelectionShape::Lasso:
+        painter.drawPolyline(m_lasso);
+        break;
+    }
+    painter.restore();
+}
+
+// -------------------
+// MagicWandTool
+// -------------------
+MagicWandTool::MagicWandTool(LayerManager* layers, ToolManager* tools, QObject* parent)
+    : Tool(parent)
+    , m_layerManager(layers)
+    , m_toolManager(tools)
+{
+}
+
+void MagicWandTool::mousePress(const StrokeSample& sample)
+{
+    const QPoint pos = sample.pixel();
+    if (!m_layerManager || !m_toolManager) return;
+
+    const bool merged = m_toolManager->sampleMerged();
+    const Layer* layer = m_layerManager->layerAt(m_layerManager->activeLayerIndex());
+    if (!merged && !layer) return;
+
+    const QImage& image = merged ? m_layerManager->mergedImage() : layer->image();
+    const SelectionOp op = selectionOpFromModifiers();
+
+    QPoint offset;
+    const QImage mask = FloodFill::regionMask(image, pos, m_toolManager->tolerance(),
+                                              m_toolManager->selectionAntialias(), offset);
+    // Щелчок мимо холста снимает выделение так же, как у остальных инструментов выделения
+    const Selection region = mask.isNull() ? Selection() : Selection::fromMask(mask, offset);
+    if (region.isEmpty() && op != SelectionOp::Replace)
+        return;
+    m_layerManager->setSelection(m_layerManager->selection().combined(region, op));
+}
+
+// -------------------
+// GradientTool
+// -------------------
+GradientTool::GradientTool(LayerManager* layers, CommandManager* commands, ColorManager* colors, ToolManager* tools,
+                           QObject* parent)
+    : Tool(parent)
+    , m_layerManager(layers)
+    , m_commandManager(commands)
+    , m_colorManager(colors)
+    , m_toolManager(tools)
+{
+}
+
+Gradient::Settings GradientTool::settings(bool dither) const
+{
+    Gradient::Settings result;
+    result.shape = m_toolManager->gradientShape();
+    result.start = m_start;
+    result.end = m_end;
+    result.stops = { { 0.0, m_colorManager->primaryColor() }, { 1.0, m_colorManager->secondaryColor() } };
+    result.dither = dither;
+    return result;
+}
+
+// Shift выравнивает направление по шагу 45 градусов
+QPointF GradientTool::constrained(const QPointF& pos) const
+{
+    if (!(QGuiApplication::queryKeyboardModifiers() & Qt::ShiftModifier))
+        return pos;
+
+    const QLineF line(m_start, pos);
+    QLineF snapped = line;
+    snapped.setAngle(qRound(line.angle() / 45.0) * 45.0);
+    return snapped.p2();
+}
+
+void GradientTool::mousePress(const StrokeSample& sample)
+{
+    if (!m_layerManager || !m_colorManager || !m_toolManager) return;
+    const Layer* layer = m_layerManager->activeLayer();
     if (!layer) return;
 
-    m_lastPos = pos;
+    const Selection& selection = m_layerManager->selection();
+    m_area = selection.isEmpty() ? layer->image().rect() : selection.bounds() & layer->image().rect();
+    if (m_area.isEmpty()) return;
+
+    m_start = sample.pos;
+    m_end = sample.pos;
+    m_drawing = true;
+    renderPreview();
+}
+
+void GradientTool::mouseMove(const QVector<StrokeSample>& samples)
+{
+    if (!m_drawing || samples.isEmpty()) return;
+
+    m_end = constrained(samples.last().pos);
+    renderPreview();
+}
+
+void GradientTool::mouseRelease(const StrokeSample& sample)
+{
+    if (!m_drawing) return;
+
+    m_end = constrained(sample.pos);
     m_drawing = false;
+    m_preview = QImage();
+    emit overlayChanged(m_area);
 
-    QImage tmp = m_startImage;
-    {
-        QPainter p(&tmp);
-        p.setRenderHint(QPainter::Antialiasing);
-        p.setPen(QPen(m_colorManager->secondaryColor(), m_toolManager->brushSize(), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-        p.setBrush(m_colorManager->primaryColor());
-        QRect rect = normalizedSquare(m_startPos, m_lastPos, QApplication::keyboardModifiers() & Qt::ShiftModifier);
-        p.drawEllipse(rect);
+    // Щелчок без протяжки ничего не заливает
+    if (QLineF(m_start, m_end).length() < 1.0)
+        return;
+
+    // Полное разрешение считается один раз, по полосам строк в пуле потоков
+    QImage fill(m_area.size(), QImage::Format_ARGB32_Premultiplied);
+    Gradient::render(fill, QRectF(m_area), settings(m_toolManager->gradientDither()));
+    const QRect area = m_area;
+    commitShape(m_layerManager, m_commandManager, area, [&](QPainter& p) { p.drawImage(area.topLeft(), fill); });
+}
+
+void GradientTool::renderPreview()
+{
+    // Уменьшенная копия: ее растягивает painter при отрисовке
+    const qreal scale = qMin<qreal>(1.0, qreal(GRADIENT_PREVIEW_SIZE) / qMax(m_area.width(), m_area.height()));
+    const QSize size(qMax(1, qCeil(m_area.width() * scale)), qMax(1, qCeil(m_area.height() * scale)));
+    if (m_preview.size() != size)
+        m_preview = QImage(size, QImage::Format_ARGB32_Premultiplied);
+
+    Gradient::render(m_preview, QRectF(m_area), settings(false));
+    emit overlayChanged(m_area);
+}
+
+void GradientTool::paintOverlay(QPainter& painter)
+{
+    if (!m_drawing || m_preview.isNull()) return;
+
+    paintShapePreview(painter, m_layerManager, m_area, [this](QPainter& p) {
+        p.setRenderHint(QPainter::SmoothPixmapTransform, true);
+        p.drawImage(QRectF(m_area), m_preview);
+    });
+
+    painter.save();
+    QPen pen(Qt::white, 0, Qt::DashLine);
+    painter.setPen(pen);
+    painter.drawLine(m_start, m_end);
+    painter.restore();
+}
+
+// -------------------
+// TransformTool
+// -------------------
+TransformTool::TransformTool(LayerManager* layers, CommandManager* commands, QObject* parent)
+    : Tool(parent)
+    , m_layerManager(layers)
+    , m_commandManager(commands)
+{
+    if (!m_layerManager) return;
+
+    // Поднятые пиксели - снимок слоя: если слой изменился помимо инструмента
+    // (отмена, фильтр, коррекция), применение вернуло бы старое содержимое
+    connect(m_layerManager, &LayerManager::layerPixelsChanged, this, [this](int index, const QRect&) {
+        const Layer* layer = m_layerManager->layerAt(index);
+        if (m_active && layer && layer->id() == m_layerId)
+            cancel();
+    });
+    connect(m_layerManager, &LayerManager::layersReset, this, [this]() {
+        if (m_active)
+            cancel();
+    });
+}
+
+bool TransformTool::begin()
+{
+    const Layer* layer = m_layerManager ? m_layerManager->activeLayer() : nullptr;
+    if (!layer) return false;
+
+    const QImage& image = layer->image();
+    const Selection& selection = m_layerManager->selection();
+    m_source = selection.isEmpty() ? image.rect() : selection.bounds() & image.rect();
+    if (m_source.isEmpty()) return false;
+
+    // Пиксели поднимаются со слоя: копия ослабляется маской выделения,
+    // а на слое это место будет стерто той же маской
+    m_floating = image.copy(m_source);
+    if (!m_hole.begin(m_layerManager, Qt::black, StrokeBuffer::Mode::Erase)) return false;
+    if (selection.isEmpty()) {
+        const QByteArray opaque(m_source.width(), char(255));
+        m_hole.mergeMax(reinterpret_cast<const uchar*>(opaque.constData()), 0, m_source);
+    } else {
+        const QImage& mask = selection.mask();
+        const QRect bounds = selection.bounds();
+        m_hole.mergeMax(mask.constBits(), mask.bytesPerLine(), bounds);
+        // m_source лежит внутри границ выделения: строки маски читаются напрямую
+        for (int y = 0; y < m_floating.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(m_floating.scanLine(y));
+            const uchar* cover = mask.constScanLine(m_source.top() + y - bounds.top()) + (m_source.left() - bounds.left());
+            for (int x = 0; x < m_floating.width(); ++x)
+                line[x] = PixelOps::byteMul(line[x], cover[x]);
+        }
+    }
+
+    // Предпросмотр всегда рисуется из уменьшенной копии
+    m_proxy = qMax(m_floating.width(), m_floating.height()) > TRANSFORM_PROXY_SIZE
+        ? m_floating.scaled(TRANSFORM_PROXY_SIZE, TRANSFORM_PROXY_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+        : m_floating;
+
+    m_layerId = layer->id();
+    m_offset = QPointF();
+    m_angle = 0.0;
+    m_scaleX = 1.0;
+    m_scaleY = 1.0;
+    m_active = true;
+    updateOverlay();
+    return true;
+}
+
+QPointF TransformTool::center() const
+{
+    return QRectF(m_source).center() + m_offset;
+}
+
+QTransform TransformTool::transform() const
+{
+    // Масштаб и поворот вокруг центра исходной области, затем сдвиг
+    const QPointF origin = QRectF(m_source).center();
+    QTransform t;
+    t.translate(origin.x() + m_offset.x(), origin.y() + m_offset.y());
+    t.rotate(m_angle);
+    t.scale(m_scaleX, m_scaleY);
+    t.translate(-origin.x(), -origin.y());
+    return t;
+}
+
+QRect TransformTool::overlayBounds() const
+{
+    if (!m_active) return QRect();
+    const int margin = TRANSFORM_HANDLE_SIZE;
+    return transform().mapRect(QRectF(m_source)).toAlignedRect().adjusted(-margin, -margin, margin, margin);
+}
+
+void TransformTool::updateOverlay()
+{
+    const QRect old = m_overlayRect;
+    m_overlayRect = overlayBounds();
+    emit overlayChanged(old | m_overlayRect);
+}
+
+void TransformTool::mousePress(const StrokeSample& sample)
+{
+    if (!m_active && !begin()) return;
+
+    m_pressPos = sample.pos;
+    m_pressOffset = m_offset;
+    m_pressAngle = m_angle;
+
+    // Угол рамки - масштаб, внутри рамки - сдвиг, снаружи - поворот
+    const QPolygonF frame = transform().map(QPolygonF(QRectF(m_source)));
+    const qreal reach = qMax<qreal>(TRANSFORM_HANDLE_SIZE, 0.03 * frame.boundingRect().width());
+    m_drag = frame.containsPoint(sample.pos, Qt::OddEvenFill) ? Drag::Move : Drag::Rotate;
+    for (int i = 0; i < 4; ++i) {
+        if (QLineF(frame[i], sample.pos).length() <= reach)
+            m_drag = Drag::Scale;
     }
+}
+
+void TransformTool::mouseMove(const QVector<StrokeSample>& samples)
+{
+    if (!m_active || m_drag == Drag::None || samples.isEmpty()) return;
+
+    const QPointF pos = samples.last().pos;
+    const bool shift = QGuiApplication::queryKeyboardModifiers() & Qt::ShiftModifier;
+
+    switch (m_drag) {
+    case Drag::Move:
+        m_offset = m_pressOffset + (pos - m_pressPos);
+        break;
+    case Drag::Scale: {
+        // Угол тянется в повернутой системе рамки, масштаб симметричен относительно центра
+        const QPointF local = QTransform().rotate(-m_angle).map(pos - center());
+        m_scaleX = qMax(0.01, qAbs(local.x()) / (m_source.width() / 2.0));
+        m_scaleY = qMax(0.01, qAbs(local.y()) / (m_source.height() / 2.0));
+        if (shift)
+            m_scaleX = m_scaleY = qMax(m_scaleX, m_scaleY);
+        break;
+    }
+    case Drag::Rotate: {
+        const QPointF from = m_pressPos - center();
+        const QPointF to = pos - center();
+        m_angle = m_pressAngle + qRadiansToDegrees(qAtan2(to.y(), to.x()) - qAtan2(from.y(), from.x()));
+        if (shift)
+            m_angle = qRound(m_angle / 15.0) * 15.0;
+        break;
+    }
+    case Drag::None:
+        break;
+    }
+    updateOverlay();
+}
+
+void TransformTool::mouseRelease(const StrokeSample& sample)
+{
+    Q_UNUSED(sample)
+    m_drag = Drag::None;
+}
+
+void TransformTool::paintOverlay(QPainter& painter)
+{
+    if (!m_active) return;
+
+    painter.save();
+    const QTransform t = transform();
+
+    // Уменьшенная копия растягивается до исходной области и преобразуется вместе с ней
+    QTransform proxyToImage;
+    proxyToImage.translate(m_source.left(), m_source.top());
+    proxyToImage.scale(qreal(m_source.width()) / m_proxy.width(), qreal(m_source.height()) / m_proxy.height());
+    painter.setTransform(proxyToImage * t, true);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    painter.drawImage(QPointF(0, 0), m_proxy);
+    painter.restore();
+
+    painter.save();
+    const QPolygonF frame = t.map(QPolygonF(QRectF(m_source)));
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(QPen(Qt::black, 0, Qt::DashLine));
+    painter.drawPolygon(frame);
+    QPen handles(Qt::white, TRANSFORM_HANDLE_SIZE, Qt::SolidLine, Qt::SquareCap);
+    handles.setCosmetic(true);
+    painter.setPen(handles);
+    for (int i = 0; i < 4; ++i)
+        painter.drawPoint(frame[i]);
+    painter.restore();
+}
+
+bool TransformTool::keyPress(QKeyEvent* event)
+{
+    if (!m_active) return false;
+
+    switch (event->key()) {
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        apply();
+        return true;
+    case Qt::Key_Escape:
+        cancel();
+        return true;
+    default:
+        return false;
+    }
+}
+
+void TransformTool::deactivate()
+{
+    if (m_active)
+        apply();
+}
+
+void TransformTool::cancel()
+{
+    if (!m_active) return;
+
+    const QRect hole = m_hole.bounds();
+    m_active = false;
+    m_drag = Drag::None;
+    m_hole.clear();
+    m_floating = QImage();
+    m_proxy = QImage();
+    updateOverlay();
+    emit overlayChanged(hole);
+}
+
+void TransformTool::apply()
+{
+    Layer* layer = m_layerManager->layerById(m_layerId);
+    // Слой удалили или сменили ему размер, пока шла настройка
+    if (!layer || !layer->image().rect().contains(m_source)) {
+        cancel();
+        return;
+    }
+
+    QImage& image = layer->image();
+    QTransform sourceToImage;
+    sourceToImage.translate(m_source.left(), m_source.top());
+    sourceToImage = sourceToImage * transform();
+
+    const QRect target = sourceToImage.mapRect(QRectF(m_floating.rect())).toAlignedRect() & image.rect();
+    const QRect changed = m_source | target;
+    const QImage before = image.copy(changed);
 
-    layer->setImage(tmp);
-    m_layerManager->layersChanged();
+    // Стираем исходное место и кладем пересчитанные пиксели в полном разрешении
+    m_hole.composite(image, QPoint(), m_source);
+    Resample::drawTransformed(image, m_floating, sourceToImage, image.rect());
 
-    m_commandManager->ExecuteCommand(new DrawCommand(m_layerManager, idx, m_startImage, tmp));
+    QVector<ImagePatch> patches;
+    patches.append({ changed.topLeft(), before, image.copy(changed) });
+    cancel();
+    m_commandManager->ExecuteCommand(new DrawCommand(m_layerManager, m_layerId, patches));
 }
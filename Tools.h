@@ -3,9 +3,24 @@
 
 #include <QObject>
 #include <QPoint>
+#include <QPointF>
 #include <QImage>
+#include <QVector>
+#include <QPolygonF>
+#include <QTransform>
 #include "toolmanager.h"
-
+#include "StrokeSample.h"
+#include "StrokeInterpolator.h"
+#include "Commands.h"
+#include "PaintSession.h"
+#include "BrushEngine.h"
+#include "StrokeBuffer.h"
+#include "PixelStroke.h"
+#include "Gradient.h"
+
+class QPainter;
+class QKeyEvent;
+class RegionLabelCache;
 class LayerManager;
 class CommandManager;
 class ColorManager;
@@ -17,24 +32,49 @@ public:
     explicit Tool(QObject* parent = nullptr) : QObject(parent) {}
     virtual ~Tool() = default;
 
-    virtual void mousePress(const QPoint& pos) = 0;
-    virtual void mouseMove(const QPoint& pos) = 0;
-    virtual void mouseRelease(const QPoint& pos) = 0;
+    virtual void mousePress(const StrokeSample& sample) = 0;
+    // Все отсчеты, накопленные LayerView за кадр, в порядке поступления
+    virtual void mouseMove(const QVector<StrokeSample>& samples) = 0;
+    virtual void mouseRelease(const StrokeSample& sample) = 0;
+
+    // Рисует предсказанное продолжение штриха поверх холста (координаты изображения)
+    virtual void paintPrediction(QPainter& painter, const QPolygonF& path) { Q_UNUSED(painter) Q_UNUSED(path) }
+
+    // Движение без нажатия (LayerView следит за мышью постоянно)
+    virtual void hoverMove(const StrokeSample& sample) { Q_UNUSED(sample) }
+    // Подсказки инструмента поверх слоев, в координатах изображения
+    virtual void paintOverlay(QPainter& painter) { Q_UNUSED(painter) }
+    // Незавершенный штрих, который LayerView накладывает поверх его слоя
+    virtual const StrokeBuffer* strokeBuffer() const { return nullptr; }
+    // Ослаблять ли штрих маской выделения при показе; false, если маска уже в буфере
+    virtual bool strokeMaskedBySelection() const { return true; }
+
+    // Клавиши, пока холст в фокусе; true - клавиша обработана
+    virtual bool keyPress(QKeyEvent* event) { Q_UNUSED(event) return false; }
+    // Вызывается при смене инструмента, чтобы завершить незаконченную операцию
+    virtual void deactivate() {}
+    // Бросает незаконченную операцию, не трогая слой (перед отменой и повтором)
+    virtual void cancel() {}
+
+signals:
+    // Часть холста, где изменилась подсказка инструмента
+    void overlayChanged(const QRect& imageRect);
 };
 
 class EyedropperTool : public Tool
 {
     Q_OBJECT
 public:
-    EyedropperTool(LayerManager* layers, ColorManager* colors, QObject* parent = nullptr);
+    EyedropperTool(LayerManager* layers, ColorManager* colors, ToolManager* tools, QObject* parent = nullptr);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override {}
-    void mouseRelease(const QPoint& pos) override {}
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override {}
+    void mouseRelease(const StrokeSample& sample) override {}
 
 private:
     LayerManager* m_layerManager;
     ColorManager* m_colorManager;
+    ToolManager* m_toolManager;
 };
 
 class PencilTool : public Tool
@@ -43,9 +83,11 @@ class PencilTool : public Tool
 public:
     PencilTool(LayerManager* layers, CommandManager* commands, ColorManager* colors, ToolManager* toolManager, QObject* parent);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override;
-    void mouseRelease(const QPoint& pos) override;
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    const StrokeBuffer* strokeBuffer() const override { return &m_stroke; }
+    void paintPrediction(QPainter& painter, const QPolygonF& path) override;
 
 private:
     LayerManager* m_layerManager;
@@ -54,9 +96,16 @@ private:
     ToolManager* m_toolManager;
     int m_brushSize;
 
+    // Рисует участок сглаженной кривой от m_lastPos
+    void drawSamples(const QVector<StrokeSample>& samples);
+
     bool m_drawing = false;
-    QPoint m_lastPos;
-    QImage m_startImage;
+    QPointF m_lastPos;
+    qreal m_lastPressure = 1.0;
+    StrokeInterpolator m_interpolator;
+    StrokeBuffer m_stroke;
+    bool m_pixelPath = false;
+    PixelStroke m_pixels;
 };
 
 class BrushTool : public Tool
@@ -65,9 +114,11 @@ class BrushTool : public Tool
 public:
     BrushTool(LayerManager* layers, CommandManager* commands, ColorManager* colors, ToolManager* toolManager, QObject* parent);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override;
-    void mouseRelease(const QPoint& pos) override;
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    const StrokeBuffer* strokeBuffer() const override { return &m_stroke; }
+    void paintPrediction(QPainter& painter, const QPolygonF& path) override;
 
 private:
     LayerManager* m_layerManager;
@@ -76,9 +127,15 @@ private:
     ToolManager* m_toolManager;
     int m_brushSize;
 
+    // Рисует участок сглаженной кривой от m_lastPos
+    void drawSamples(const QVector<StrokeSample>& samples);
+
     bool m_drawing = false;
-    QPoint m_lastPos;
-    QImage m_startImage;
+    QPointF m_lastPos;
+    qreal m_lastPressure = 1.0;
+    StrokeInterpolator m_interpolator;
+    BrushEngine m_engine;
+    StrokeBuffer m_stroke;
 };
 
 class EraserTool : public Tool
@@ -87,9 +144,10 @@ class EraserTool : public Tool
 public:
     EraserTool(LayerManager* layers, CommandManager* commands, ToolManager* toolManager, QObject* parent);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override;
-    void mouseRelease(const QPoint& pos) override;
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    const StrokeBuffer* strokeBuffer() const override { return &m_stroke; }
 
 private:
     LayerManager* m_layerManager;
@@ -98,9 +156,14 @@ private:
     ToolManager* m_toolManager;
     int m_brushSize;
 
+    // Рисует участок сглаженной кривой от m_lastPos
+    void drawSamples(const QVector<StrokeSample>& samples);
+
     bool m_erasing = false;
-    QPoint m_lastPos;
-    QImage m_startImage;
+    QPointF m_lastPos;
+    qreal m_lastPressure = 1.0;
+    StrokeInterpolator m_interpolator;
+    StrokeBuffer m_stroke;
 };
 
 class FillTool : public Tool
@@ -109,9 +172,11 @@ class FillTool : public Tool
 public:
     FillTool(LayerManager* layers, CommandManager* commands, ColorManager* colors, ToolManager* tools, QObject* parent = nullptr);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override {}
-    void mouseRelease(const QPoint& pos) override;
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override {}
+    void mouseRelease(const StrokeSample& sample) override;
+    void hoverMove(const StrokeSample& sample) override;
+    void paintOverlay(QPainter& painter) override;
 
 private:
     LayerManager* m_layerManager;
@@ -119,9 +184,18 @@ private:
     ColorManager* m_colorManager;
     ToolManager* m_toolManager;
 
-    QImage m_startImage;
+    // Заливка делается на нажатии, в историю уходит на отпускании
+    PaintSession m_session;
 
-    void floodFill(QImage& image, const QPoint& start, const QColor& color);
+    // Разметка областей для мгновенной повторной заливки и подсветки под курсором
+    bool syncRegionCache();
+    void clearHover();
+
+    RegionLabelCache* m_regionCache = nullptr;
+    quint32 m_hoverLabel = 0;
+    QRect m_hoverRect;
+    QRect m_hoverOverlayRect;   // часть m_hoverRect, для которой построена маска
+    QImage m_hoverOverlay;
 };
 
 class LineTool : public Tool
@@ -134,9 +208,10 @@ public:
              ToolManager* tm,
              QObject* parent = nullptr);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override;
-    void mouseRelease(const QPoint& pos) override;
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    void paintOverlay(QPainter& painter) override;
 
 private:
     LayerManager* m_layerManager;
@@ -144,10 +219,15 @@ private:
     ColorManager* m_colorManager;
     ToolManager* m_toolManager;
 
+    // Пока фигуру тянут, она рисуется только поверх холста; в слой - при отпускании
+    QRect shapeBounds() const;
+    void drawShape(QPainter& p) const;
+    void updateOverlay();
+
     QPoint m_startPos;
     QPoint m_lastPos;
 
-    QImage m_startImage;
+    QRect m_shapeRect;
     bool m_drawing = false;
 };
 
@@ -161,9 +241,10 @@ public:
              ToolManager* tm,
              QObject* parent = nullptr);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override;
-    void mouseRelease(const QPoint& pos) override;
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    void paintOverlay(QPainter& painter) override;
 
 private:
     LayerManager* m_layerManager;
@@ -171,10 +252,16 @@ private:
     ColorManager* m_colorManager;
     ToolManager* m_toolManager;
 
+    // Пока фигуру тянут, она рисуется только поверх холста; в слой - при отпускании
+    QRect shapeRect() const;
+    QRect shapeBounds() const;
+    void drawShape(QPainter& p) const;
+    void updateOverlay();
+
     QPoint m_startPos;
     QPoint m_lastPos;
 
-    QImage m_startImage;
+    QRect m_shapeRect;
     bool m_drawing = false;
 };
 
@@ -188,9 +275,10 @@ public:
                 ToolManager* tm,
                 QObject* parent = nullptr);
 
-    void mousePress(const QPoint& pos) override;
-    void mouseMove(const QPoint& pos) override;
-    void mouseRelease(const QPoint& pos) override;
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    void paintOverlay(QPainter& painter) override;
 
 private:
     LayerManager* m_layerManager;
@@ -198,10 +286,150 @@ private:
     ColorManager* m_colorManager;
     ToolManager* m_toolManager;
 
+    // Пока фигуру тянут, она рисуется только поверх холста; в слой - при отпускании
+    QRect shapeRect() const;
+    QRect shapeBounds() const;
+    void drawShape(QPainter& p) const;
+    void updateOverlay();
+
     QPoint m_startPos;
     QPoint m_lastPos;
 
-    QImage m_startImage;
+    QRect m_shapeRect;
     bool m_drawing = false;
 };
+
+// Форма, которую задает инструмент выделения
+enum class SelectionShape {
+    Rectangle,
+    Ellipse,
+    Lasso
+};
+
+class SelectionTool : public Tool
+{
+    Q_OBJECT
+public:
+    SelectionTool(LayerManager* layers, SelectionShape shape, QObject* parent = nullptr);
+
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    void paintOverlay(QPainter& painter) override;
+
+private:
+    void updateOverlay();
+
+    LayerManager* m_layerManager;
+    SelectionShape m_shape;
+
+    bool m_dragging = false;
+    QPoint m_startPos;
+    QPoint m_lastPos;
+    QPolygonF m_lasso;
+    QRect m_overlayRect;
+};
+
+// Выделяет связную область похожего цвета с допуском ToolManager::tolerance()
+class MagicWandTool : public Tool
+{
+    Q_OBJECT
+public:
+    MagicWandTool(LayerManager* layers, ToolManager* tools, QObject* parent = nullptr);
+
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override {}
+    void mouseRelease(const StrokeSample& sample) override {}
+
+private:
+    LayerManager* m_layerManager;
+    ToolManager* m_toolManager;
+};
+
+// Градиент от основного цвета к дополнительному по всему слою (или выделению).
+// Пока его тянут, на экране уменьшенная копия; в слой - при отпускании
+class GradientTool : public Tool
+{
+    Q_OBJECT
+public:
+    GradientTool(LayerManager* layers, CommandManager* commands, ColorManager* colors, ToolManager* tools,
+                 QObject* parent = nullptr);
+
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    void paintOverlay(QPainter& painter) override;
+
+private:
+    Gradient::Settings settings(bool dither) const;
+    QPointF constrained(const QPointF& pos) const;
+    void renderPreview();
+
+    LayerManager* m_layerManager;
+    CommandManager* m_commandManager;
+    ColorManager* m_colorManager;
+    ToolManager* m_toolManager;
+
+    bool m_drawing = false;
+    QPointF m_start;
+    QPointF m_end;
+    QRect m_area;       // что будет залито, в координатах слоя
+    QImage m_preview;
+};
+
+// Перемещение, масштаб и поворот слоя или выделенной части.
+// Пока преобразование настраивается, на экране только уменьшенная копия;
+// полное разрешение пересчитывается один раз при применении (Enter или смена инструмента).
+class TransformTool : public Tool
+{
+    Q_OBJECT
+public:
+    TransformTool(LayerManager* layers, CommandManager* commands, QObject* parent = nullptr);
+
+    void mousePress(const StrokeSample& sample) override;
+    void mouseMove(const QVector<StrokeSample>& samples) override;
+    void mouseRelease(const StrokeSample& sample) override;
+    void paintOverlay(QPainter& painter) override;
+    const StrokeBuffer* strokeBuffer() const override { return &m_hole; }
+    bool strokeMaskedBySelection() const override { return false; }
+    bool keyPress(QKeyEvent* event) override;
+    void deactivate() override;
+    void cancel() override;
+
+private:
+    enum class Drag {
+        None,
+        Move,
+        Scale,
+        Rotate
+    };
+
+    bool begin();
+    void apply();
+    QTransform transform() const;
+    QPointF center() const;
+    QRect overlayBounds() const;
+    void updateOverlay();
+
+    LayerManager* m_layerManager;
+    CommandManager* m_commandManager;
+
+    bool m_active = false;
+    LayerId m_layerId = 0;
+    QRect m_source;        // что преобразуется, в координатах слоя
+    QImage m_floating;     // эти пиксели в полном разрешении (с учетом маски выделения)
+    QImage m_proxy;        // уменьшенная копия для предпросмотра
+    StrokeBuffer m_hole;   // место, откуда пиксели подняты
+
+    QPointF m_offset;
+    qreal m_angle = 0.0;
+    qreal m_scaleX = 1.0;
+    qreal m_scaleY = 1.0;
+
+    Drag m_drag = Drag::None;
+    QPointF m_pressPos;
+    QPointF m_pressOffset;
+    qreal m_pressAngle = 0.0;
+    QRect m_overlayRect;
+};
 #endif // TOOLS_H
@@ -6,6 +6,8 @@
 #include <QButtonGroup>
 #include <QSlider>
 #include <QLabel>
+#include <QCheckBox>
+#include <QComboBox>
 
 ToolsWidget::ToolsWidget(ToolManager* toolManager, ColorManager* colorManager, QWidget* parent)
     : QWidget(parent)
@@ -64,6 +66,14 @@ void ToolsWidget::setupUI()
 
     addTool(ToolType::Rectangle,  "Прямоугольник",  2, 0);
     addTool(ToolType::Ellipse,    "Элипс",    2, 1);
+    addTool(ToolType::RectSelect, "Выделение", 2, 2);
+
+    addTool(ToolType::EllipseSelect, "Овал",   3, 0);
+    addTool(ToolType::Lasso,      "Лассо",      3, 1);
+    addTool(ToolType::MagicWand,  "Палочка",    3, 2);
+
+    addTool(ToolType::Transform,  "Трансформ",  4, 0);
+    addTool(ToolType::Gradient,   "Градиент",   4, 1);
 
     mainLayout->addLayout(toolsGrid);
 
@@ -137,6 +147,75 @@ void ToolsWidget::setupUI()
     slidersLayout->addWidget(m_fillToleranceContainer);
 
     mainLayout->addWidget(slidersContainer);
+
+    // ----------------------------
+    //        НАЖИМ ПЕРА
+    // ----------------------------
+
+    m_pressureCheckBox = new QCheckBox("Нажим");
+    m_pressureCheckBox->setStyleSheet("color: white;");
+    m_pressureCheckBox->setToolTip("Толщина и прозрачность зависят от нажима пера планшета");
+    m_pressureCheckBox->setChecked(m_toolManager && m_toolManager->usePressure());
+    mainLayout->addWidget(m_pressureCheckBox);
+
+    m_pixelPerfectCheckBox = new QCheckBox("Пиксель в пиксель");
+    m_pixelPerfectCheckBox->setStyleSheet("color: white;");
+    m_pixelPerfectCheckBox->setToolTip("Убирать угловые пиксели на ступеньках линии толщиной 1 px");
+    m_pixelPerfectCheckBox->setChecked(m_toolManager && m_toolManager->pixelPerfect());
+    mainLayout->addWidget(m_pixelPerfectCheckBox);
+
+    // ----------------------------
+    //      РЕЖИМ ЗАЛИВКИ
+    // ----------------------------
+
+    m_globalFillCheckBox = new QCheckBox("Все похожие");
+    m_globalFillCheckBox->setStyleSheet("color: white;");
+    m_globalFillCheckBox->setToolTip("Заменить цвет во всем слое, а не только в связной области");
+    mainLayout->addWidget(m_globalFillCheckBox);
+
+    // ----------------------------
+    //   ЗАЛИВКА И ПИПЕТКА ПО СЛОЯМ
+    // ----------------------------
+
+    m_sampleMergedCheckBox = new QCheckBox("По всем слоям");
+    m_sampleMergedCheckBox->setStyleSheet("color: white;");
+    m_sampleMergedCheckBox->setToolTip("Брать цвет из видимого изображения, а не только из активного слоя");
+    mainLayout->addWidget(m_sampleMergedCheckBox);
+
+    m_eyedropperSizeCombo = new QComboBox();
+    m_eyedropperSizeCombo->setToolTip("Область усреднения цвета");
+    for (int size : { 1, 3, 5, 11 })
+        m_eyedropperSizeCombo->addItem(size == 1 ? QString("Один пиксель")
+                                                 : QString("Среднее %1x%1").arg(size), size);
+    mainLayout->addWidget(m_eyedropperSizeCombo);
+
+    // ----------------------------
+    //     СГЛАЖИВАНИЕ ВЫДЕЛЕНИЯ
+    // ----------------------------
+
+    m_selectionAntialiasCheckBox = new QCheckBox("Сглаживание");
+    m_selectionAntialiasCheckBox->setStyleSheet("color: white;");
+    m_selectionAntialiasCheckBox->setToolTip("Мягкий край у выделения волшебной палочкой");
+    m_selectionAntialiasCheckBox->setChecked(m_toolManager ? m_toolManager->selectionAntialias() : true);
+    mainLayout->addWidget(m_selectionAntialiasCheckBox);
+
+    // ----------------------------
+    //          ГРАДИЕНТ
+    // ----------------------------
+
+    m_gradientShapeCombo = new QComboBox();
+    m_gradientShapeCombo->setToolTip("Форма градиента");
+    m_gradientShapeCombo->addItem("Линейный", int(GradientShape::Linear));
+    m_gradientShapeCombo->addItem("Радиальный", int(GradientShape::Radial));
+    m_gradientShapeCombo->addItem("Угловой", int(GradientShape::Angular));
+    mainLayout->addWidget(m_gradientShapeCombo);
+
+    m_gradientDitherCheckBox = new QCheckBox("Дизеринг");
+    m_gradientDitherCheckBox->setStyleSheet("color: white;");
+    m_gradientDitherCheckBox->setToolTip("Смешивать соседние уровни, чтобы на плавном переходе не было полос");
+    m_gradientDitherCheckBox->setChecked(m_toolManager ? m_toolManager->gradientDither() : true);
+    mainLayout->addWidget(m_gradientDitherCheckBox);
+
     mainLayout->addStretch();
 }
 
@@ -161,6 +240,46 @@ void ToolsWidget::setupConnections()
             }
             );
 
+    connect(m_pressureCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        if (m_toolManager)
+            m_toolManager->setUsePressure(checked);
+    });
+
+    connect(m_pixelPerfectCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        if (m_toolManager)
+            m_toolManager->setPixelPerfect(checked);
+    });
+
+    connect(m_globalFillCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        if (m_toolManager)
+            m_toolManager->setFillMode(checked ? FillMode::Global : FillMode::Contiguous);
+    });
+
+    connect(m_sampleMergedCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        if (m_toolManager)
+            m_toolManager->setSampleMerged(checked);
+    });
+
+    connect(m_eyedropperSizeCombo, &QComboBox::currentIndexChanged, this, [this](int index) {
+        if (m_toolManager)
+            m_toolManager->setEyedropperSize(m_eyedropperSizeCombo->itemData(index).toInt());
+    });
+
+    connect(m_selectionAntialiasCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        if (m_toolManager)
+            m_toolManager->setSelectionAntialias(checked);
+    });
+
+    connect(m_gradientShapeCombo, &QComboBox::currentIndexChanged, this, [this](int index) {
+        if (m_toolManager)
+            m_toolManager->setGradientShape(static_cast<GradientShape>(m_gradientShapeCombo->itemData(index).toInt()));
+    });
+
+    connect(m_gradientDitherCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        if (m_toolManager)
+            m_toolManager->setGradientDither(checked);
+    });
+
 }
 
 bool ToolsWidget::toolHasBrushSize(ToolType tool)
@@ -179,6 +298,18 @@ bool ToolsWidget::toolHasBrushSize(ToolType tool)
     }
 }
 
+bool ToolsWidget::toolHasPressure(ToolType tool)
+{
+    switch (tool) {
+    case ToolType::Pencil:
+    case ToolType::Brush:
+    case ToolType::Eraser:
+        return true;
+    default:
+        return false;
+    }
+}
+
 void ToolsWidget::onToolButtonClicked()
 {
     QToolButton* button = qobject_cast<QToolButton*>(sender());
@@ -210,10 +341,20 @@ void ToolsWidget::updateToolSelection()
     m_brushSizeSlider->setVisible(show);
     m_brushSizeLabel->setVisible(show);
 
-    bool fillVisible = (currentTool == ToolType::Fill);
-    m_fillToleranceContainer->setVisible(fillVisible);
+    m_pressureCheckBox->setVisible(toolHasPressure(currentTool));
+    m_pixelPerfectCheckBox->setVisible(currentTool == ToolType::Pencil);
 
-    if (fillVisible) {
+    bool fillVisible = (currentTool == ToolType::Fill);
+    bool wandVisible = (currentTool == ToolType::MagicWand);
+    m_fillToleranceContainer->setVisible(fillVisible || wandVisible);
+    m_globalFillCheckBox->setVisible(fillVisible);
+    m_sampleMergedCheckBox->setVisible(fillVisible || wandVisible || currentTool == ToolType::Eyedropper);
+    m_eyedropperSizeCombo->setVisible(currentTool == ToolType::Eyedropper);
+    m_selectionAntialiasCheckBox->setVisible(wandVisible);
+    m_gradientShapeCombo->setVisible(currentTool == ToolType::Gradient);
+    m_gradientDitherCheckBox->setVisible(currentTool == ToolType::Gradient);
+
+    if (fillVisible || wandVisible) {
         m_fillToleranceSlider->setValue(m_toolManager->tolerance());
     }
 
@@ -9,6 +9,8 @@
 class QToolButton;
 class QSlider;
 class QLabel;
+class QCheckBox;
+class QComboBox;
 
 class ToolsWidget : public QWidget
 {
@@ -29,6 +31,8 @@ private:
 
     // Определяет, должен ли показываться слайдер размера для выбранного инструмента
     bool toolHasBrushSize(ToolType tool);
+    // Инструменты, которые учитывают нажим пера
+    bool toolHasPressure(ToolType tool);
 
 private:
     ToolManager* m_toolManager;
@@ -47,6 +51,15 @@ private:
     QLabel*  m_fillToleranceLabel = nullptr;
     QLabel*  m_fillToleranceValueLabel = nullptr;
 
+    QCheckBox* m_pressureCheckBox = nullptr;
+    QCheckBox* m_pixelPerfectCheckBox = nullptr;
+    QCheckBox* m_globalFillCheckBox = nullptr;
+    QCheckBox* m_sampleMergedCheckBox = nullptr;
+    QComboBox* m_eyedropperSizeCombo = nullptr;
+    QCheckBox* m_selectionAntialiasCheckBox = nullptr;
+    QComboBox* m_gradientShapeCombo = nullptr;
+    QCheckBox* m_gradientDitherCheckBox = nullptr;
+
 };
 
 #endif // TOOLSWIDGET_H
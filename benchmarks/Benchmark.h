@@ -0,0 +1,39 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QElapsedTimer>
+#include <cstdio>
+#include <limits>
+
+// Общие части консольных замеров: лучшее время из нескольких прогонов и строка отчета
+namespace Benchmark
+{
+    // prepare вызывается перед каждым прогоном и в замер не входит
+    template <typename Prepare, typename Run>
+    double bestMs(int repeats, Prepare prepare, Run run)
+    {
+        double best = std::numeric_limits<double>::max();
+        QElapsedTimer timer;
+        for (int i = 0; i < repeats; ++i) {
+            prepare();
+            timer.start();
+            run();
+            const double ms = timer.nsecsElapsed() / 1e6;
+            if (ms < best)
+                best = ms;
+        }
+        return best;
+    }
+
+    inline double megapixelsPerSecond(qint64 pixels, double ms)
+    {
+        return ms > 0.0 ? pixels / (ms * 1000.0) : 0.0;
+    }
+
+    inline void report(const char* name, const char* variant, qint64 pixels, double ms)
+    {
+        std::printf("%-28s %-12s %10.2f ms %10.1f MP/s\n", name, variant, ms, megapixelsPerSecond(pixels, ms));
+    }
+}
+
+#endif // BENCHMARK_H
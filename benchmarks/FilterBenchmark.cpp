@@ -0,0 +1,62 @@
+#include "Filters.h"
+#include "Benchmark.h"
+#include <QRandomGenerator>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+namespace
+{
+
+// Шум с полупрозрачностью: фильтры работают с premultiplied цветом на всех каналах
+QImage makeNoise(int size)
+{
+    QRandomGenerator random(11);
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < size; ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < size; ++x) {
+            const int alpha = 128 + random.bounded(128);
+            line[x] = qPremultiply(qRgba(random.bounded(256), random.bounded(256), random.bounded(256), alpha));
+        }
+    }
+    return image;
+}
+
+}
+
+// Скорость фильтров слоя по радиусам, в MP/s. Аргумент - сторона изображения, по умолчанию 4096
+int main(int argc, char* argv[])
+{
+    const int size = argc > 1 ? qMax(16, std::atoi(argv[1])) : 4096;
+    const QImage source = makeNoise(size);
+    const qint64 pixels = qint64(size) * size;
+    const int radii[] = { 1, 2, 3, 5, 10, 25, 50, 100, 250 };
+
+    struct Filter
+    {
+        const char* name;
+        std::function<void(QImage&, int)> run;
+    };
+    const Filter filters[] = {
+        { "gaussian", [](QImage& image, int r) { Filters::gaussianBlur(image, r); } },
+        { "box", [](QImage& image, int r) { Filters::boxBlur(image, r); } },
+        { "unsharp", [](QImage& image, int r) { Filters::unsharpMask(image, r, 1.0, 0); } },
+        { "motion", [](QImage& image, int r) { Filters::motionBlur(image, 2 * r, 30.0); } },
+    };
+
+    for (const Filter& filter : filters) {
+        for (int radius : radii) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%s r=%d", filter.name, radius);
+            char variant[32];
+            std::snprintf(variant, sizeof(variant), "%dx%d", size, size);
+
+            QImage image;
+            const double ms = Benchmark::bestMs(3, [&] { image = source.copy(); },
+                                                [&] { filter.run(image, radius); });
+            Benchmark::report(name, variant, pixels, ms);
+        }
+    }
+    return 0;
+}
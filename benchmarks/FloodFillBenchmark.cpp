@@ -0,0 +1,101 @@
+#include "FloodFill.h"
+#include "Benchmark.h"
+#include <QColor>
+#include <QStack>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+
+// Прежняя заливка: по пикселю через стек и QColor, без учета альфы. Оставлена как база для сравнения
+void legacyFill(QImage& image, const QPoint& start, const QColor& color, int tolerance)
+{
+    if (start.x() < 0 || start.y() < 0 || start.x() >= image.width() || start.y() >= image.height())
+        return;
+
+    QColor targetColor = image.pixelColor(start);
+
+    auto withinTolerance = [&](const QColor& a, const QColor& b) {
+        return (std::abs(a.red()   - b.red())   <= tolerance &&
+                std::abs(a.green() - b.green()) <= tolerance &&
+                std::abs(a.blue()  - b.blue())  <= tolerance);
+    };
+
+    if (withinTolerance(targetColor, color))
+        return;
+    QStack<QPoint> stack;
+    stack.push(start);
+
+    while (!stack.isEmpty()) {
+        QPoint p = stack.pop();
+        if (p.x() < 0 || p.y() < 0 || p.x() >= image.width() || p.y() >= image.height())
+            continue;
+        if (!withinTolerance(image.pixelColor(p), targetColor))
+            continue;
+
+        image.setPixelColor(p, color);
+
+        stack.push(QPoint(p.x() + 1, p.y()));
+        stack.push(QPoint(p.x() - 1, p.y()));
+        stack.push(QPoint(p.x(), p.y() + 1));
+        stack.push(QPoint(p.x(), p.y() - 1));
+    }
+}
+
+// Белый холст с черными горизонтальными стенами и проходами в них:
+// область связная, но распадается на множество отрезков строк
+QImage makeScene(int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    const QRgb wall = qRgb(0, 0, 0);
+    for (int y = 16; y < size; y += 16) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < size; ++x) {
+            if ((x + y) % 256 >= 8)
+                line[x] = wall;
+        }
+    }
+    return image;
+}
+
+}
+
+// Сравнение заливки по отрезкам строк с прежней попиксельной.
+// Аргументы - размеры стороны холста, по умолчанию 1K, 4K и 16K
+int main(int argc, char* argv[])
+{
+    QVector<int> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.append(std::atoi(argv[i]));
+    if (sizes.isEmpty())
+        sizes = { 1024, 4096, 16384 };
+
+    const QColor color(200, 30, 30);
+    const QPoint seed(0, 0);
+
+    for (int size : sizes) {
+        if (size <= 0)
+            continue;
+        const QImage scene = makeScene(size);
+        const qint64 pixels = qint64(size) * size;
+        const int repeats = size <= 4096 ? 3 : 1;
+        char name[32];
+        std::snprintf(name, sizeof(name), "fill %dx%d", size, size);
+
+        QImage legacy;
+        const double legacyMs = Benchmark::bestMs(repeats, [&] { legacy = scene.copy(); },
+                                                  [&] { legacyFill(legacy, seed, color, 0); });
+        Benchmark::report(name, "per-pixel", pixels, legacyMs);
+
+        QImage spans;
+        const double spanMs = Benchmark::bestMs(repeats, [&] { spans = scene.copy(); },
+                                                [&] { FloodFill::fill(spans, seed, color, 0); });
+        Benchmark::report(name, "spans", pixels, spanMs);
+
+        std::printf("%-28s %-12s %10.1fx%s\n", name, "speedup", legacyMs / qMax(spanMs, 1e-6),
+                    legacy == spans ? "" : "   RESULTS DIFFER");
+    }
+    return 0;
+}
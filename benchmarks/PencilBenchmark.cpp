@@ -0,0 +1,102 @@
+#include "PixelStroke.h"
+#include "StrokeBuffer.h"
+#include "LayerManager.h"
+#include "Benchmark.h"
+#include "Config.h"
+#include <QPainter>
+#include <QPolygonF>
+#include <QRandomGenerator>
+#include <cstdio>
+
+namespace
+{
+
+const int CanvasSize = 4096;
+const int SamplesPerFrame = 8;
+
+// Случайное блуждание с шагом в несколько пикселей, как отсчеты мыши при быстром штрихе
+QVector<QPoint> makePath(int count)
+{
+    QRandomGenerator random(7);
+    QVector<QPoint> path;
+    path.reserve(count);
+    QPoint pos(CanvasSize / 2, CanvasSize / 2);
+    for (int i = 0; i < count; ++i) {
+        pos += QPoint(random.bounded(-6, 7), random.bounded(-6, 7));
+        pos.setX(qBound(0, pos.x(), CanvasSize - 1));
+        pos.setY(qBound(0, pos.y(), CanvasSize - 1));
+        path.append(pos);
+    }
+    return path;
+}
+
+// Прежний путь карандаша: кадр отсчетов одной ломаной QPainter во временную маску черновика
+void paintWithPainter(StrokeBuffer& stroke, const QVector<QPoint>& path, int size)
+{
+    for (int i = 1; i < path.size(); i += SamplesPerFrame) {
+        QPolygonF run;
+        run << path[i - 1];
+        for (int j = i; j < qMin(i + SamplesPerFrame, int(path.size())); ++j)
+            run << path[j];
+
+        const QRect bounds = run.boundingRect().toAlignedRect().adjusted(-size, -size, size, size);
+        stroke.paint(bounds, [&](QPainter& painter) {
+            painter.setPen(QPen(Qt::black, size, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+            painter.drawPolyline(run);
+        });
+    }
+}
+
+// Путь по пикселям: Брезенхэм и штамп прямо в плитки черновика
+void paintWithPixels(StrokeBuffer& stroke, const QVector<QPoint>& path, int size, bool pixelPerfect)
+{
+    PixelStroke pixels;
+    pixels.begin(stroke, path.first(), size, 256, pixelPerfect);
+    for (int i = 1; i < path.size(); ++i)
+        pixels.lineTo(stroke, path[i], size, 256);
+    pixels.finish(stroke);
+}
+
+// Площадь штриха: шагов Брезенхэма на всем пути, умноженных на ширину кисти
+qint64 strokeArea(const QVector<QPoint>& path, int size)
+{
+    qint64 steps = 1;
+    for (int i = 1; i < path.size(); ++i) {
+        const QPoint d = path[i] - path[i - 1];
+        steps += qMax(qAbs(d.x()), qAbs(d.y()));
+    }
+    return steps * size;
+}
+
+}
+
+// Пропускная способность карандаша: пиксельный путь против QPainter на одном и том же штрихе.
+// MP/s считаются по площади штриха
+int main()
+{
+    LayerManager layers;
+    layers.createNewLayer(QSize(CanvasSize, CanvasSize), "bench");
+    const QVector<QPoint> path = makePath(200000);
+
+    for (int size = 1; size <= PENCIL_PIXEL_MAX_SIZE; ++size) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "pencil %d px", size);
+        StrokeBuffer stroke;
+        const qint64 area = strokeArea(path, size);
+
+        const double painterMs = Benchmark::bestMs(3, [&] { stroke.begin(&layers, Qt::black, StrokeBuffer::Mode::Paint); },
+                                                   [&] { paintWithPainter(stroke, path, size); });
+        Benchmark::report(name, "QPainter", area, painterMs);
+
+        const double pixelMs = Benchmark::bestMs(3, [&] { stroke.begin(&layers, Qt::black, StrokeBuffer::Mode::Paint); },
+                                                 [&] { paintWithPixels(stroke, path, size, false); });
+        Benchmark::report(name, "pixels", area, pixelMs);
+
+        if (size == 1) {
+            const double perfectMs = Benchmark::bestMs(3, [&] { stroke.begin(&layers, Qt::black, StrokeBuffer::Mode::Paint); },
+                                                       [&] { paintWithPixels(stroke, path, size, true); });
+            Benchmark::report(name, "pixel-perfect", area, perfectMs);
+        }
+    }
+    return 0;
+}
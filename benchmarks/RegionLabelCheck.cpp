@@ -0,0 +1,115 @@
+#include "RegionLabelCache.h"
+#include "LayerManager.h"
+#include "FloodFill.h"
+#include "Benchmark.h"
+#include <QCoreApplication>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <cstdio>
+
+namespace
+{
+
+// Прямоугольники и эллипсы нескольких цветов поверх друг друга: много областей
+// разной формы, в том числе с дырами и узкими перешейками
+QImage makeScene(int size, QRandomGenerator& random)
+{
+    const QColor palette[] = { Qt::white, Qt::black, QColor(40, 120, 200), QColor(40, 120, 201) };
+
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setPen(Qt::NoPen);
+    for (int i = 0; i < 400; ++i) {
+        painter.setBrush(palette[random.bounded(4)]);
+        const QRect rect(random.bounded(size), random.bounded(size), 4 + random.bounded(size / 8), 4 + random.bounded(size / 8));
+        if (i % 2)
+            painter.drawEllipse(rect);
+        else
+            painter.drawRect(rect);
+    }
+    return image;
+}
+
+void waitReady(RegionLabelCache& cache)
+{
+    while (!cache.isReady())
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+}
+
+// Заливает копии source двумя путями из одних и тех же точек и сравнивает результат.
+// Возвращает число расхождений
+int compare(LayerManager& layers, RegionLabelCache& cache, QRandomGenerator& random, int fills)
+{
+    const QImage source = layers.layerAt(0)->image();
+    const QColor color(250, 10, 10);
+    const QRgb fillPixel = qPremultiply(color.rgba());
+    const qint64 pixels = qint64(source.width()) * source.height();
+
+    int mismatches = 0;
+    double floodMs = 0.0;
+    double labelMs = 0.0;
+    for (int i = 0; i < fills; ++i) {
+        const QPoint seed(random.bounded(source.width()), random.bounded(source.height()));
+
+        QImage expected;
+        floodMs += Benchmark::bestMs(1, [&] { expected = source.copy(); },
+                                     [&] { FloodFill::fill(expected, seed, color, 0); });
+
+        quint32 label = cache.labelAt(seed);
+        if (label == 0) {
+            // Крупная правка запустила полную переразметку в фоне
+            waitReady(cache);
+            label = cache.labelAt(seed);
+        }
+
+        QImage actual;
+        labelMs += Benchmark::bestMs(1, [&] { actual = source.copy(); },
+                                     [&] { cache.fillRegion(actual, label, fillPixel, actual.rect()); });
+
+        if (actual != expected) {
+            std::printf("mismatch at (%d, %d)\n", seed.x(), seed.y());
+            ++mismatches;
+        }
+    }
+
+    Benchmark::report("fill from seed", "flood fill", pixels * fills, floodMs);
+    Benchmark::report("fill from seed", "labels", pixels * fills, labelMs);
+    return mismatches;
+}
+
+}
+
+// Проверка, что заливка по готовой разметке совпадает с заливкой FloodFill
+// от той же точки - после первой разметки и после частичной переразметки правок.
+// Возвращает 1 при расхождении
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QRandomGenerator random(2024);
+    const int size = 1024;
+    const int fills = 200;
+
+    LayerManager layers;
+    Layer* layer = layers.createNewLayer(QSize(size, size), "check");
+    layers.setLayerImage(0, makeScene(size, random));
+
+    RegionLabelCache cache(&layers);
+    cache.setSource(layer->id());
+    waitReady(cache);
+
+    int mismatches = compare(layers, cache, random, fills);
+
+    // Мелкие правки: разметка обновляется только вокруг них
+    for (int i = 0; i < 20; ++i) {
+        const QRect rect(random.bounded(size - 40), random.bounded(size - 40), 8 + random.bounded(32), 8 + random.bounded(32));
+        QPainter painter(&layer->image());
+        painter.fillRect(rect, i % 2 ? Qt::black : Qt::white);
+        painter.end();
+        layers.notifyPixelsChanged(0, rect);
+    }
+    mismatches += compare(layers, cache, random, fills);
+
+    std::printf("%d mismatches\n", mismatches);
+    return mismatches ? 1 : 0;
+}
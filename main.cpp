@@ -6,6 +6,9 @@
 
 int main(int argc, char *argv[])
 {
+    // Планшет отдает 200-1000 отсчетов в секунду, и каждый из них нужен штриху
+    QCoreApplication::setAttribute(Qt::AA_CompressTabletEvents, false);
+
     QApplication a(argc, argv);
 
     StartWindow start;
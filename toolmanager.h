@@ -20,9 +20,35 @@ public:
     bool usePressure() const { return m_usePressure; }
     void setUsePressure(bool use);
 
+    // Карандаш в 1 px убирает угловые пиксели ступенек
+    bool pixelPerfect() const { return m_pixelPerfect; }
+    void setPixelPerfect(bool enabled);
+
     int tolerance() const{ return m_tolerance; }
     void setTolerance(int);
 
+    FillMode fillMode() const { return m_fillMode; }
+    void setFillMode(FillMode mode);
+
+    // Заливка и пипетка смотрят на композит всех видимых слоев
+    bool sampleMerged() const { return m_sampleMerged; }
+    void setSampleMerged(bool merged);
+
+    // Сторона квадрата, по которому пипетка усредняет цвет (1, 3, 5, 11)
+    int eyedropperSize() const { return m_eyedropperSize; }
+    void setEyedropperSize(int size);
+
+    // Волшебная палочка сглаживает край выделения
+    bool selectionAntialias() const { return m_selectionAntialias; }
+    void setSelectionAntialias(bool antialias);
+
+    GradientShape gradientShape() const { return m_gradientShape; }
+    void setGradientShape(GradientShape shape);
+
+    // Градиент с дизерингом не дает полос на плавных переходах
+    bool gradientDither() const { return m_gradientDither; }
+    void setGradientDither(bool dither);
+
 
 signals:
     void toolChanged(ToolType tool);
@@ -32,7 +58,14 @@ private:
     ToolType m_currentTool;
     int m_brushSize;
     bool m_usePressure;
+    bool m_pixelPerfect = false;
     int m_tolerance = 0;
+    FillMode m_fillMode = FillMode::Contiguous;
+    bool m_sampleMerged = false;
+    int m_eyedropperSize = 1;
+    bool m_selectionAntialias = true;
+    GradientShape m_gradientShape = GradientShape::Linear;
+    bool m_gradientDither = true;
 };
 
 #endif // TOOLMANAGER_H